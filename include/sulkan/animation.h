@@ -5,11 +5,15 @@
 #include <cglm/cglm.h>
 #include <sulkan/model.h>
 #include <sulkan/bone.h>
+#include <sulkan/camera.h>
 
 typedef struct skAssimpNodeData
 {
     mat4 transformation;
     char name[128];
+    skStringID nameId;
+    // Index of the animation's bone for this node, -1 if it has none
+    int boneIndex;
     int childrenCount;
     skVector* children; // skAssimpNodeData
 } skAssimpNodeData;
@@ -17,11 +21,40 @@ typedef struct skAssimpNodeData
 typedef struct skAnimation
 {
     skVector* bones; // skBone
-    skMap* boneInfoMap; // char*, skBoneInfo
+    skMap* boneInfoMap; // skStringID, skBoneInfo, NULL in a library
     float duration;
     int ticksPerSecond;
     skAssimpNodeData rootNode;
     char name[128];
+
+    // The node hierarchy flattened depth first, every node comes
+    // after its parent so the pose is computed in one loop
+    int   nodeCount;
+    int*  nodeParents;    // -1 for the root
+    mat4* nodeTransforms; // Local transforms of the nodes
+    skStringID* nodeNames;
+
+    // The local transforms split up for blending, w is 1 for the
+    // positions and scales so they can be blended as vec4s
+    vec4* nodePositions;
+    vec4* nodeRotations; // Quaternions
+    vec4* nodeScales;
+
+    // The bones the animation moves and the node each one drives
+    int  channelCount;
+    int* channelBones; // Index into bones
+    int* channelNodes;
+    // The longer of each channel's offset from its parent and how far
+    // its children reach. Animation LODs stop animating channels
+    // smaller than their minBoneSize
+    float* channelSizes;
+
+    // Nodes with bone info, the index of their final bone matrix and
+    // their offset
+    int   skinCount;
+    int*  skinNodes;
+    int*  skinBoneIds;
+    mat4* skinOffsets;
 } skAnimation;
 
 skAnimation skAnimation_Create(const struct aiAnimation* aiAnim,
@@ -29,23 +62,214 @@ skAnimation skAnimation_Create(const struct aiAnimation* aiAnim,
                                skModel*    model);
 void skAnimation_Free(skAnimation* animation);
 skBone* skAnimation_FindBone(skAnimation* animation, const char* name);
+skBone* skAnimation_FindBoneByID(skAnimation* animation,
+                                 skStringID   nameId);
+// Resamples the clip's channels to 48 bit keys, dropping keys within
+// the compression's tolerances. Clips load uncompressed, compress the
+// ones that can take the loss right after acquiring their library.
+// Compressed clips sample without the animators' key cursors
+void skAnimation_Compress(skAnimation*             animation,
+                          const skBoneCompression* compression);
 
 void skAnimation_ReadMissingBones(skAnimation* animation, 
         const struct aiAnimation* aiAnim, skModel* model);
 void skAnimation_ReadHierarchyData(skAssimpNodeData* dest, const struct aiNode* src);
+void skAnimation_FlattenHierarchy(skAnimation* animation);
 void skAssimpNodeData_Free(skAssimpNodeData* nodeData);
 
+// Most layers an animator blends on top of its current animation
+#define SK_ANIMATOR_MAX_LAYERS 4
+
+typedef enum skAnimationBlendMode
+{
+    // Blends from the pose so far toward the layer's pose
+    skAnimationBlendMode_Override,
+    // Adds how far the layer's pose is from the skeleton's rest pose
+    skAnimationBlendMode_Additive,
+} skAnimationBlendMode;
+
+// A weight from 0 to 1 for every node of a skeleton, layers only
+// affect each node as much as its weight says
+typedef struct skAnimationMask
+{
+    float* weights;
+    int    count;
+} skAnimationMask;
+
+// A mask for the animation's skeleton with every node at weight
+skAnimationMask skAnimationMask_Create(skAnimation* animation,
+                                       float        weight);
+void skAnimationMask_Free(skAnimationMask* mask);
+// Sets the weight of the named node and of everything below it
+void skAnimationMask_SetNode(skAnimationMask* mask,
+                             skAnimation*     animation,
+                             const char* name, float weight);
+
+// An animation played on top of the animator's current one. It has
+// to be on the same skeleton, so an animation from the same model
+typedef struct skAnimationLayer
+{
+    skAnimation*           animation;
+    const skAnimationMask* mask; // NULL for every node
+    skAnimationBlendMode   mode;
+    float                  weight;
+    float                  currentTime;
+    skKeyCursor*           cursors;
+    int                    cursorCapacity;
+} skAnimationLayer;
+
+// The animations of a model file, loaded once and shared by every
+// animator made from a model with that path. They're freed when the
+// last animator using them is. Only use from the main thread
+typedef struct skAnimationLibrary
+{
+    // skAnimation, don't change them apart from skAnimation_Compress
+    skVector*   animations;
+    skStringID  path;
+    int         refCount;
+    skJobGroup* loading; // Until the load is waited for
+} skAnimationLibrary;
+
+// Returns the library for the model's path, loading it the first
+// time, or NULL if the file has no animations
+skAnimationLibrary* skAnimationLibrary_Acquire(skModel* model);
+// Same, but a first load runs on the job system next to the model
+// and image loads. Neither the library nor the model, which gets the
+// bones only the clips have, can be used before
+// skAnimationLibrary_Wait. Always returns a library, without any
+// animations if the file has none
+skAnimationLibrary* skAnimationLibrary_AcquireAsync(skModel* model);
+void skAnimationLibrary_Wait(skAnimationLibrary* library);
+void skAnimationLibrary_Release(skAnimationLibrary* library);
+
+// Most detail levels an animator can have
+#define SK_ANIMATOR_MAX_LODS 4
+
+typedef struct skAnimationLOD
+{
+    float distance;      // Used from this far from the camera on
+    int   frameInterval; // Evaluate the pose every this many updates
+    float minBoneSize;   // Smaller bones keep their last pose
+} skAnimationLOD;
+
+struct skAnimationSystem;
+
 typedef struct skAnimator
 {
+    // Points into the system's arena while the animator is in one,
+    // don't resize it then
     skVector* finalBoneMatrices; // mat4
-    skVector* animations; // skAnimation
+    skAnimationLibrary* library;
+    skVector* animations; // skAnimation, the library's
     skAnimation* currentAnimation;
+    mat4* pose; // Model space transform of every node
+    // Local transform of every node as last evaluated, held by the
+    // channels a LOD skips
+    mat4* localPose;
+    int poseCapacity;
+    skKeyCursor* cursors; // One for every bone of the animation
+    int cursorCapacity;
     float currentTime;
     float deltaTime;
+
+    // The animation skAnimator_CrossFade is fading out of, it's
+    // dropped once fadeTime reaches fadeDuration
+    skAnimation* previousAnimation;
+    float previousTime;
+    skKeyCursor* previousCursors;
+    int previousCursorCapacity;
+    float fadeTime;
+    float fadeDuration;
+
+    skAnimationLayer layers[SK_ANIMATOR_MAX_LAYERS];
+    int layerCount;
+
+    // Translations, rotations and scales of the pose being blended
+    // and of the one being blended in, 6 for every node. Only used
+    // while fading or with layers
+    vec4* blendPose;
+    int blendCapacity;
+
+    // Detail levels from near to far, only used when updated with a
+    // camera. Closer than the first level is full detail
+    skAnimationLOD lods[SK_ANIMATOR_MAX_LODS];
+    int lodCount;
+    vec3 position; // Where the character is, set it every frame
+    int lod; // The level in use, -1 for full detail
+
+    // With a frame interval the bone matrices are blended from the
+    // pose evaluated before the last one to the last one, kept as a
+    // translation, rotation and scale for every bone. lodFrame counts
+    // down to the next evaluation, -1 when starting over
+    vec4* lodFrom;
+    vec4* lodTo;
+    int lodCapacity;
+    int lodFrame;
+
+    // The system updating the animator, NULL for none, and its entry
+    // there. boneStorage keeps finalBoneMatrices' own memory meanwhile
+    struct skAnimationSystem* system;
+    size_t systemIndex;
+    void** boneStorage;
 } skAnimator;
 
 skAnimator skAnimator_Create(skModel* model);
 void skAnimator_UpdateAnimation(skAnimator* animator, float dt);
+// Updates at the detail level for the distance from the animator's
+// position to cameraPosition
+void skAnimator_UpdateAnimationLOD(skAnimator* animator, float dt,
+                                   vec3 cameraPosition);
+// Adds a detail level further away than the ones before it, returns
+// false if there's no room
+bool skAnimator_AddLOD(skAnimator* animator, float distance,
+                       int frameInterval, float minBoneSize);
 void skAnimator_PlayAnimation(skAnimator* animator, skAnimation* anim);
-void skAnimator_CalculateBoneTransform(skAnimator* animator, skAssimpNodeData* node, 
-        mat4 parentTransform);
+// Plays anim, blending to it from what's playing over duration
+// seconds
+void skAnimator_CrossFade(skAnimator* animator, skAnimation* anim,
+                          float duration);
+// Returns the index of the new layer or -1 if there's no room, the
+// mask has to stay alive as long as the layer
+int skAnimator_AddLayer(skAnimator* animator, skAnimation* anim,
+                        skAnimationBlendMode   mode,
+                        const skAnimationMask* mask, float weight);
+void skAnimator_SetLayerWeight(skAnimator* animator, int layer,
+                               float weight);
+// The layers after it move down one
+void skAnimator_RemoveLayer(skAnimator* animator, int layer);
+// Removes the animator from its system, releases its library and
+// frees its bone matrices and buffers
+void skAnimator_Free(skAnimator* animator);
+void skAnimator_CalculateBoneTransforms(skAnimator* animator);
+
+typedef struct skAnimationSystemEntry
+{
+    skAnimator* animator;
+    size_t      boneOffset; // Index of its first matrix in the arena
+} skAnimationSystemEntry;
+
+// Updates many animators at once on the job system. Animators playing
+// the same clip on the same skeleton are updated next to each other.
+// Their finalBoneMatrices point into one arena, one animator's after
+// the other, so the renderer and skinning read the system's poses
+typedef struct skAnimationSystem
+{
+    skVector* entries;      // skAnimationSystemEntry
+    mat4*     boneMatrices; // The arena
+    size_t    boneCount;
+    size_t    boneCapacity;
+    float     deltaTime;
+    skCamera* camera; // Picks the animators' LODs, NULL for none
+} skAnimationSystem;
+
+skAnimationSystem skAnimationSystem_Create(void);
+void skAnimationSystem_Destroy(skAnimationSystem* system);
+void skAnimationSystem_Add(skAnimationSystem* system,
+                           skAnimator*        animator);
+void skAnimationSystem_Remove(skAnimationSystem* system,
+                              skAnimator*        animator);
+void skAnimationSystem_Update(skAnimationSystem* system, float dt);
+// The animator's bone matrices in the arena, NULL if it isn't in the
+// system. Valid until an animator is added or removed
+mat4* skAnimationSystem_GetBoneMatrices(skAnimationSystem* system,
+                                        skAnimator*        animator);
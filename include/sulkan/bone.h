@@ -3,55 +3,119 @@
 #include <sulkan/vector.h>
 #include <cglm/cglm.h>
 #include <assimp/scene.h>
+#include <sulkan/string_id.h>
+#include <stdbool.h>
+#include <stdint.h>
 
-typedef struct skKeyPosition
+// Compressed channels whose keys aren't evenly spaced already are
+// resampled at this many keys per second before redundant keys are
+// dropped
+#define SK_BONE_SAMPLE_RATE 30.0f
+// Default tolerances for compressing a channel, see skBoneCompression
+#define SK_BONE_POSITION_TOLERANCE 0.001f
+#define SK_BONE_ROTATION_TOLERANCE 0.0005f
+#define SK_BONE_SCALE_TOLERANCE    0.0005f
+
+// How far a compressed channel may drift from the original before a
+// key is kept, in model units for positions and scales and in
+// quaternion components for rotations
+typedef struct skBoneCompression
 {
-    vec3 position;
-    float timeStamp;
-} skKeyPosition;
+    float positionTolerance;
+    float rotationTolerance;
+    float scaleTolerance;
+} skBoneCompression;
+
+#define SK_BONE_COMPRESSION_DEFAULT                          \
+    ((skBoneCompression) {SK_BONE_POSITION_TOLERANCE,        \
+                          SK_BONE_ROTATION_TOLERANCE,        \
+                          SK_BONE_SCALE_TOLERANCE})
 
-typedef struct skKeyRotation
+// Where sampling a bone's channels left off last time, kept by
+// whoever plays the animation so playing forward only has to look at
+// the next key or two
+typedef struct skKeyCursor
 {
-    vec4 rotation; // Quaternion
-    float timeStamp;
-} skKeyRotation;
+    int position;
+    int rotation;
+    int scale;
+} skKeyCursor;
 
-typedef struct skKeyScale
+// A channel stored as 48 bits per key at a uniform rate over the
+// animation. Positions and scales are 16 bits per component inside
+// the channel's range, rotations keep the three smallest components
+// in 15 bits each and the index of the largest in 2
+typedef struct skCompressedTrack
 {
-    vec3 scale;
-    float timeStamp;
-} skKeyScale;
+    uint16_t* keys;  // 3 for every key
+    int       count; // 1 if the channel never changes
+    vec3      rangeMin;
+    vec3      rangeExtent;
+} skCompressedTrack;
 
 typedef struct skBone
 {
-    skVector* positions; // skPosition
-    skVector* rotations; // skRotation
-    skVector* scales; // skScale
+    // Keys are kept as separate arrays of times and values so the
+    // search only touches the times
+    float* positionTimes;
+    vec3*  positionValues;
+    float* rotationTimes;
+    vec4*  rotationValues; // Quaternions
+    float* scaleTimes;
+    vec3*  scaleValues;
     int numPositions;
     int numRotations;
     int numScales;
 
-    mat4 localTransform;
+    // Replace the keys above once skBone_Compress has been called
+    bool              compressed;
+    float             duration;
+    skCompressedTrack positionTrack;
+    skCompressedTrack rotationTrack;
+    skCompressedTrack scaleTrack;
+
     char name[128];
+    skStringID nameId;
     int ID;
 } skBone;
 
 skBone skBone_Create(const char* name, int ID, const struct aiNodeAnim* channel);
-void skBone_Update(skBone* bone, float animationTime);
+void skBone_Free(skBone* bone);
+// Resamples and quantizes the keys and frees the original ones,
+// duration and ticksPerSecond are the animation's. Lossy, and sampling
+// a compressed bone doesn't use the key cursor
+void skBone_Compress(skBone* bone, float duration,
+                     float ticksPerSecond,
+                     const skBoneCompression* compression);
+// Samples the bone's local translation, rotation and scale at
+// animationTime
+void skBone_Sample(skBone* bone, float animationTime,
+                   skKeyCursor* cursor, vec3 position, vec4 rotation,
+                   vec3 scale);
+// Samples the bone's local transform at animationTime into dest
+void skBone_Update(skBone* bone, float animationTime,
+                   skKeyCursor* cursor, mat4 dest);
 
+// Finds the key before animationTime, starting from the cursor and
+// falling back to a binary search when the time jumped
+int skBone_FindKey(const float* times, int count, float animationTime,
+                   int* cursor);
 // Get the current position key frame we're at
-int skBone_GetPositionIndex(skBone* bone, float animationTime);
+int skBone_GetPositionIndex(skBone* bone, float animationTime,
+                            skKeyCursor* cursor);
 // Get the current rotation key frame we're at
-int skBone_GetRotationIndex(skBone* bone, float animationTime);
+int skBone_GetRotationIndex(skBone* bone, float animationTime,
+                            skKeyCursor* cursor);
 // Get the current scale key frame we're at
-int skBone_GetScaleIndex(skBone* bone, float animationTime);
+int skBone_GetScaleIndex(skBone* bone, float animationTime,
+                         skKeyCursor* cursor);
 
 float skGetScaleFactor(float lastTimeStamp, float nextTimeStamp,
                        float animationTime);
 
 void skBone_InterpolatePosition(skBone* bone, float animationTime,
-                                mat4 dest);
+                                skKeyCursor* cursor, mat4 dest);
 void skBone_InterpolateRotation(skBone* bone, float animationTime,
-                                mat4 dest);
+                                skKeyCursor* cursor, mat4 dest);
 void skBone_InterpolateScale(skBone* bone, float animationTime,
-                               mat4 dest);
+                             skKeyCursor* cursor, mat4 dest);
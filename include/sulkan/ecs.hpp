@@ -1,7 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <bitset>
+#include <cstdint>
 #include <vector>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+#include <sulkan/job_system.hpp>
 
 // This file implements a basic ECS which is the core of the engine
 
@@ -10,7 +16,26 @@ inline int componentCounter = 0;
 
 // Max constants
 const int MAX_COMPONENTS = 200;
-const int MAX_ENTITIES = 1000;
+
+// Default amount of entities a scene may hold, can be changed per
+// scene with Scene::SetEntityBudget
+const size_t DEFAULT_ENTITY_BUDGET = 1 << 20;
+
+// Amount of components in one page of a component pool
+const size_t POOL_PAGE_SIZE = 256;
+
+// Size in bytes of a single archetype chunk
+const size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+
+// How the components of a scene are stored
+enum class StorageMode
+{
+    // One pool per component type, indexed by the entity index
+    Sparse,
+    // Entities with the same component mask are packed together in
+    // chunks, one contiguous column per component type
+    Archetype
+};
 
 // Typedefs to aid in reading
 typedef std::bitset<MAX_COMPONENTS> ComponentMask;
@@ -53,28 +78,314 @@ template<class T> int GetId()
     return componentId;
 }
 
+// When a component was added and when it was last written, in scene
+// change ticks (see Scene::changeTick)
+struct ComponentTicks
+{
+    uint32_t added;
+    uint32_t changed;
+};
+
+// Compares two ticks in a way that survives the counter wrapping
+inline bool IsNewerTick(uint32_t tick, uint32_t since)
+{
+    return (int32_t)(tick - since) > 0;
+}
+
 // Memory pool for the components
-// Just stores chars
+// Just stores chars, split into pages of POOL_PAGE_SIZE components
+// that only get allocated once an entity in their range actually has
+// the component
 struct ComponentPool
 {
-    ComponentPool(size_t elementsize)
+    ComponentPool(size_t elementsize) { elementSize = elementsize; }
+
+    ~ComponentPool()
     {
-        // We'll allocate enough memory to hold MAX_ENTITIES, each
-        // with element size
-        elementSize = elementsize;
-        pData = new char[elementSize * MAX_ENTITIES];
+        for (char* page : pages) { delete[] page; }
+        for (ComponentTicks* page : tickPages) { delete[] page; }
     }
 
-    ~ComponentPool() { delete[] pData; }
-
     inline void* get(size_t index)
     {
-        // looking up the component at the desired index
-        return pData + index * elementSize;
+        // looking up the component at the desired index, the page has
+        // to be acquired already
+        return pages[index / POOL_PAGE_SIZE] +
+               (index % POOL_PAGE_SIZE) * elementSize;
     }
 
+    inline ComponentTicks& ticks(size_t index)
+    {
+        return tickPages[index / POOL_PAGE_SIZE]
+                        [index % POOL_PAGE_SIZE];
+    }
+
+    // Marks the slot at index as used, allocating its page if needed
+    void* acquire(size_t index)
+    {
+        size_t page = index / POOL_PAGE_SIZE;
+
+        if (pages.size() <= page)
+        {
+            pages.resize(page + 1, nullptr);
+            tickPages.resize(page + 1, nullptr);
+            pageCounts.resize(page + 1, 0);
+        }
+        if (pages[page] == nullptr)
+        {
+            pages[page] = new char[elementSize * POOL_PAGE_SIZE];
+            tickPages[page] = new ComponentTicks[POOL_PAGE_SIZE];
+        }
+
+        pageCounts[page]++;
+        return get(index);
+    }
+
+    // Marks the slot at index as unused, the page is freed once none
+    // of its slots are used
+    void release(size_t index)
+    {
+        size_t page = index / POOL_PAGE_SIZE;
+
+        if (--pageCounts[page] == 0)
+        {
+            delete[] pages[page];
+            delete[] tickPages[page];
+            pages[page] = nullptr;
+            tickPages[page] = nullptr;
+        }
+    }
+
+    std::vector<char*>           pages;
+    std::vector<ComponentTicks*> tickPages;
+    std::vector<size_t>          pageCounts;
+    size_t                       elementSize {0};
+};
+
+// A block of memory that holds up to Archetype::chunkCapacity
+// entities, the entity ids come first followed by one contiguous
+// column per component type and then the ticks of every column
+struct ArchetypeChunk
+{
     char*  pData {nullptr};
-    size_t elementSize {0};
+    size_t count {0};
+};
+
+// Storage for every entity that has exactly the same component mask
+struct Archetype
+{
+    Archetype(const ComponentMask&       archetypeMask,
+              const std::vector<size_t>& sizes)
+       : mask(archetypeMask)
+    {
+        for (int i = 0; i < MAX_COMPONENTS; i++) columnOf[i] = -1;
+
+        // Work out how many entities fit in a chunk
+        size_t rowSize = sizeof(EntityID);
+        for (int i = 0; i < MAX_COMPONENTS; i++)
+        {
+            if (!mask.test(i))
+                continue;
+
+            columnOf[i] = (int)componentIds.size();
+            componentIds.push_back(i);
+            componentSizes.push_back(sizes[i]);
+            rowSize += sizes[i] + sizeof(ComponentTicks);
+        }
+
+        chunkCapacity = ARCHETYPE_CHUNK_SIZE / rowSize;
+        if (chunkCapacity == 0)
+            chunkCapacity = 1;
+
+        // Lay the columns out back to back, each one aligned to 16
+        // bytes so SIMD loads on them stay aligned
+        size_t offset = chunkCapacity * sizeof(EntityID);
+        for (size_t size : componentSizes)
+        {
+            offset = (offset + 15) & ~size_t(15);
+            columnOffsets.push_back(offset);
+            offset += chunkCapacity * size;
+        }
+        for (size_t i = 0; i < componentSizes.size(); i++)
+        {
+            offset = (offset + 15) & ~size_t(15);
+            tickOffsets.push_back(offset);
+            offset += chunkCapacity * sizeof(ComponentTicks);
+        }
+        chunkBytes = offset;
+    }
+
+    ~Archetype()
+    {
+        for (ArchetypeChunk& chunk : chunks)
+        {
+            ::operator delete(chunk.pData, std::align_val_t(64));
+        }
+    }
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    // Gets a component by row and column (not component id)
+    inline void* Get(size_t row, int column)
+    {
+        ArchetypeChunk& chunk = chunks[row / chunkCapacity];
+        return chunk.pData + columnOffsets[column] +
+               (row % chunkCapacity) * componentSizes[column];
+    }
+
+    // Gets the column of a component inside a chunk
+    inline char* Column(size_t chunk, int column)
+    {
+        return chunks[chunk].pData + columnOffsets[column];
+    }
+
+    inline ComponentTicks& Ticks(size_t row, int column)
+    {
+        return TickColumn(row / chunkCapacity,
+                          column)[row % chunkCapacity];
+    }
+
+    inline ComponentTicks* TickColumn(size_t chunk, int column)
+    {
+        return (ComponentTicks*)(chunks[chunk].pData +
+                                 tickOffsets[column]);
+    }
+
+    // Gets the entity ids stored inside a chunk
+    inline EntityID* Entities(size_t chunk)
+    {
+        return (EntityID*)chunks[chunk].pData;
+    }
+
+    inline EntityID& EntityAt(size_t row)
+    {
+        return Entities(row / chunkCapacity)[row % chunkCapacity];
+    }
+
+    // Appends an entity and returns its row, the component memory of
+    // that row is left uninitialized
+    size_t Push(EntityID id)
+    {
+        if (count == chunks.size() * chunkCapacity)
+        {
+            ArchetypeChunk chunk;
+            chunk.pData = static_cast<char*>(
+                ::operator new(chunkBytes, std::align_val_t(64)));
+            chunks.push_back(chunk);
+        }
+
+        size_t row = count++;
+        chunks[row / chunkCapacity].count++;
+        EntityAt(row) = id;
+        return row;
+    }
+
+    // Removes the entity at a row by moving the last entity into its
+    // place, returns the id of the entity that was moved or
+    // INVALID_ENTITY if nothing had to move
+    EntityID SwapRemove(size_t row);
+
+    ComponentMask               mask;
+    std::vector<int>            componentIds;
+    std::vector<size_t>         componentSizes;
+    std::vector<size_t>         columnOffsets;
+    std::vector<size_t>         tickOffsets;
+    int                         columnOf[MAX_COMPONENTS];
+    std::vector<ArchetypeChunk> chunks;
+    size_t                      chunkCapacity {0};
+    size_t                      chunkBytes {0};
+    size_t                      count {0};
+};
+
+inline EntityID Archetype::SwapRemove(size_t row)
+{
+    size_t   last = count - 1;
+    EntityID moved = INVALID_ENTITY;
+
+    if (row != last)
+    {
+        for (int column = 0; column < (int)componentIds.size();
+             column++)
+        {
+            std::memcpy(Get(row, column), Get(last, column),
+                        componentSizes[column]);
+            Ticks(row, column) = Ticks(last, column);
+        }
+
+        moved = EntityAt(last);
+        EntityAt(row) = moved;
+    }
+
+    chunks[last / chunkCapacity].count--;
+    count--;
+    return moved;
+}
+
+// A cached list of the entities that have a set of components, the
+// scene keeps it up to date whenever an entity's mask changes so
+// iterating it never has to look at entities that don't match
+struct SceneQuery
+{
+    inline bool Matches(const ComponentMask& entityMask) const
+    {
+        return mask == (mask & entityMask);
+    }
+
+    // Sparse storage, adds an entity to the list of matches
+    void AddMatch(EntityID id)
+    {
+        EntityIndex index = GetEntityIndex(id);
+        if (positions.size() <= index)
+        {
+            positions.resize(index + 1, size_t(-1));
+        }
+
+        positions[index] = matches.size();
+        matches.push_back(id);
+    }
+
+    // Sparse storage, removes an entity from the list of matches by
+    // moving the last match into its place
+    void RemoveMatch(EntityIndex index)
+    {
+        size_t position = positions[index];
+        matches[position] = matches.back();
+        positions[GetEntityIndex(matches[position])] = position;
+        matches.pop_back();
+        positions[index] = size_t(-1);
+    }
+
+    // Amount of entities that match
+    size_t Count() const
+    {
+        if (archetypes.empty())
+            return matches.size();
+
+        size_t count = 0;
+        for (Archetype* archetype : archetypes)
+        {
+            count += archetype->count;
+        }
+        return count;
+    }
+
+    void Reset()
+    {
+        matches.clear();
+        positions.clear();
+        archetypes.clear();
+    }
+
+    ComponentMask mask;
+
+    // Sparse storage, the matching entities and where each entity
+    // index sits in that list
+    std::vector<EntityID> matches;
+    std::vector<size_t>   positions;
+
+    // Archetype storage, every archetype that has the mask
+    std::vector<Archetype*> archetypes;
 };
 
 // Scene struct, holds all the entities, basically a registry of
@@ -86,121 +397,373 @@ struct Scene
     {
         EntityID      id;
         ComponentMask mask;
+        // Where the components live when using archetype storage
+        int    archetype {-1};
+        size_t row {0};
     };
 
-    // Creates an entity in the scene
+    Scene(StorageMode mode = StorageMode::Sparse) : storage(mode) {}
+
+    // The scene owns its queries, pointers to them are stale after
+    ~Scene()
+    {
+        Clear();
+        for (SceneQuery* query : queries) { delete query; }
+    }
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Creates an entity in the scene, returns INVALID_ENTITY if the
+    // scene's entity budget is used up
     EntityID AddEntity()
     {
+        return AddEntityWithMask(ComponentMask());
+    }
+
+    // Creates an entity that starts out with every component in the
+    // mask (zeroed), the components have to be registered. This
+    // places the entity once instead of moving it for every assign
+    EntityID AddEntityWithMask(const ComponentMask& mask)
+    {
+        EntityIndex newIndex;
+
+        if (freeEntities.empty() && entities.size() >= entityBudget)
+        {
+            return INVALID_ENTITY;
+        }
+
         if (!freeEntities.empty())
         {
-            EntityIndex newIndex = freeEntities.back();
+            newIndex = freeEntities.back();
             freeEntities.pop_back();
             EntityID newID = CreateEntityId(
                 newIndex, GetEntityVersion(entities[newIndex].id));
             entities[newIndex].id = newID;
-            return entities[newIndex].id;
         }
+        else
+        {
+            newIndex = EntityIndex(entities.size());
+            entities.push_back(
+                {CreateEntityId(newIndex, 0), ComponentMask()});
+        }
+
+        EntityDesc& desc = entities[newIndex];
+        desc.mask = mask;
+        uint32_t tick = CurrentTick();
+
+        if (storage == StorageMode::Archetype)
+        {
+            desc.archetype = GetOrCreateArchetype(mask);
+            Archetype* archetype = archetypes[desc.archetype];
+            desc.row = archetype->Push(desc.id);
+
+            for (int column = 0;
+                 column < (int)archetype->componentIds.size();
+                 column++)
+            {
+                std::memset(archetype->Get(desc.row, column), 0,
+                            archetype->componentSizes[column]);
+                archetype->Ticks(desc.row, column) = {tick, tick};
+            }
+        }
+        else
+        {
+            for (int i = 0; i < MAX_COMPONENTS; i++)
+            {
+                if (mask.test(i))
+                {
+                    std::memset(componentPools[i]->acquire(newIndex),
+                                0, componentSizes[i]);
+                    componentPools[i]->ticks(newIndex) = {tick, tick};
+                }
+            }
 
-        entities.push_back(
-            {CreateEntityId(EntityIndex(entities.size()), 0),
-             ComponentMask()});
-        return entities.back().id;
+            UpdateQueries(newIndex, ComponentMask(), false);
+        }
+
+        return desc.id;
     }
 
-    // Assigns a component to an entity ID
-    template<typename T> T* Assign(EntityID id)
+    // Sets the maximum amount of entities the scene may hold, entities
+    // that already exist are kept even if they go over the budget
+    void SetEntityBudget(size_t budget) { entityBudget = budget; }
+
+    // Tells the scene how big a component is, this has to be called
+    // before the component is assigned for the first time
+    void RegisterComponent(int componentId, size_t size)
     {
-        int componentId = GetId<T>();
+        if (componentId < 0 || componentId >= MAX_COMPONENTS)
+            return;
+
+        size_t slot = (size_t)componentId;
+        if (componentSizes.size() <= slot)
+        {
+            componentSizes.resize(slot + 1, 0);
+        }
+        componentSizes[slot] = size;
+
+        if (storage != StorageMode::Sparse)
+            return;
 
-        if (componentPools.size() <=
-            componentId) // Not enough component pool
+        if (componentPools.size() <= slot) // Not enough component pool
         {
-            componentPools.resize(componentId + 1, nullptr);
+            componentPools.resize(slot + 1, nullptr);
         }
         if (componentPools[componentId] ==
             nullptr) // New component, make a new pool
         {
-            componentPools[componentId] =
-                new ComponentPool(sizeof(T));
+            componentPools[componentId] = new ComponentPool(size);
+        }
+    }
+
+    bool IsComponentRegistered(int componentId) const
+    {
+        return componentId >= 0 &&
+               componentSizes.size() > (size_t)componentId &&
+               componentSizes[componentId] != 0;
+    }
+
+    // Assigns a component by its id, returns the existing component
+    // if the entity already has it, otherwise zeroed memory
+    void* AssignRaw(EntityID id, int componentId)
+    {
+        EntityIndex index = GetEntityIndex(id);
+
+        // Assigning over an existing component counts as a write
+        if (entities[index].mask.test(componentId))
+        {
+            MarkChanged(index, componentId);
+            return GetRaw(index, componentId);
         }
 
-        // Looks up the component in the pool, and initializes it with
-        // placement new
-        T* pComponent =
-            new (componentPools[componentId]->get(GetEntityIndex(id)))
-                T();
+        void* pComponent;
+        if (storage == StorageMode::Archetype)
+        {
+            ComponentMask newMask = entities[index].mask;
+            newMask.set(componentId);
+            MoveToArchetype(index, newMask);
+            pComponent = GetRaw(index, componentId);
+        }
+        else
+        {
+            ComponentMask oldMask = entities[index].mask;
+            pComponent = componentPools[componentId]->acquire(index);
+            entities[index].mask.set(componentId);
+            UpdateQueries(index, oldMask, true);
+        }
 
-        // Set the bit for this component to true and return the
-        // created component
-        entities[GetEntityIndex(id)].mask.set(componentId);
+        std::memset(pComponent, 0, componentSizes[componentId]);
+        uint32_t tick = CurrentTick();
+        *GetTicks(index, componentId) = {tick, tick};
         return pComponent;
     }
 
-    // Assigns a component to an entity ID with a list of parameters
-    // (a constructor). use: <ent, 1.0f, 2.0f...>
-    template<typename T, typename... Args>
-    T* AssignParam(EntityID id, Args&&... args)
+    // The added and changed ticks of a component, nullptr if the
+    // entity doesn't have it
+    ComponentTicks* GetTicks(EntityIndex index, int componentId)
     {
-        int componentId = GetId<T>();
+        if (index >= entities.size() ||
+            !entities[index].mask.test(componentId))
+            return nullptr;
 
-        if (componentPools.size() <=
-            componentId) // Not enough component pool
+        if (storage == StorageMode::Archetype)
         {
-            componentPools.resize(componentId + 1, nullptr);
+            Archetype* archetype =
+                archetypes[entities[index].archetype];
+            return &archetype->Ticks(entities[index].row,
+                                     archetype->columnOf[componentId]);
         }
-        if (componentPools[componentId] ==
-            nullptr) // New component, make a new pool
+
+        return &componentPools[componentId]->ticks(index);
+    }
+
+    // Records that a component was written to, at the current tick
+    // or at the tick of the query pass that wrote it
+    void MarkChanged(EntityIndex index, int componentId)
+    {
+        MarkChanged(index, componentId, CurrentTick());
+    }
+
+    void MarkChanged(EntityIndex index, int componentId, uint32_t tick)
+    {
+        if (ComponentTicks* ticks = GetTicks(index, componentId))
         {
-            componentPools[componentId] =
-                new ComponentPool(sizeof(T));
+            ticks->changed = tick;
         }
+    }
 
-        // Look up the component in the pool, and use placement new to
-        // initialize it with the provided arguments
-        T* pComponent =
-            new (componentPools[componentId]->get(GetEntityIndex(id)))
-                T(std::forward<Args>(args)...);
-
-        // Set the bit for this component to true and return the
-        // created component
-        entities[GetEntityIndex(id)].mask.set(componentId);
-        return pComponent;
+    uint32_t CurrentTick() const
+    {
+        return changeTick.load(std::memory_order_relaxed);
     }
 
-    // Retrieves a pointer to a given component from an entity id,
-    // use: Get<Type>(ent)
-    template<typename T> T* Get(EntityID id)
+    // Moves the change tick on and returns the tick from before,
+    // anything written from now on is newer than the returned tick
+    uint32_t AdvanceTick() { return changeTick.fetch_add(1); }
+
+    // Gets a component by its id, nullptr if the entity doesn't have
+    // it
+    void* GetRaw(EntityIndex index, int componentId)
     {
-        int componentId = GetId<T>();
-        if (!entities[GetEntityIndex(id)].mask.test(componentId))
+        if (index >= entities.size() ||
+            !entities[index].mask.test(componentId))
             return nullptr;
 
-        T* pComponent = static_cast<T*>(
-            componentPools[componentId]->get(GetEntityIndex(id)));
-        return pComponent;
+        if (storage == StorageMode::Archetype)
+        {
+            Archetype* archetype =
+                archetypes[entities[index].archetype];
+            return archetype->Get(entities[index].row,
+                                  archetype->columnOf[componentId]);
+        }
+
+        return componentPools[componentId]->get(index);
     }
 
-    // Removes a component from an entity ID
-    template<typename T> void Remove(EntityID id)
+    // Removes a component by its id
+    void RemoveRaw(EntityID id, int componentId)
     {
+        EntityIndex index = GetEntityIndex(id);
+
         // ensures you're not accessing an entity that has been
         // deleted
-        if (entities[GetEntityIndex(id)].id != id)
+        if (index >= entities.size() || entities[index].id != id ||
+            !entities[index].mask.test(componentId))
             return;
 
+        if (storage == StorageMode::Archetype)
+        {
+            ComponentMask newMask = entities[index].mask;
+            newMask.reset(componentId);
+            MoveToArchetype(index, newMask);
+        }
+        else
+        {
+            ComponentMask oldMask = entities[index].mask;
+            componentPools[componentId]->release(index);
+            entities[index].mask.reset(componentId);
+            UpdateQueries(index, oldMask, true);
+        }
+    }
+
+    // Assigns a component to an entity ID
+    template<typename T> T* Assign(EntityID id)
+    {
         int componentId = GetId<T>();
-        entities[GetEntityIndex(id)].mask.reset(componentId);
+        RegisterComponent(componentId, sizeof(T));
+
+        // Looks up the component in the storage, and initializes it
+        // with placement new
+        return new (AssignRaw(id, componentId)) T();
+    }
+
+    // Assigns a component to an entity ID with a list of parameters
+    // (a constructor). use: <ent, 1.0f, 2.0f...>
+    template<typename T, typename... Args>
+    T* AssignParam(EntityID id, Args&&... args)
+    {
+        int componentId = GetId<T>();
+        RegisterComponent(componentId, sizeof(T));
+
+        // Look up the component in the storage, and use placement new
+        // to initialize it with the provided arguments
+        return new (AssignRaw(id, componentId))
+            T(std::forward<Args>(args)...);
+    }
+
+    // Retrieves a pointer to a given component from an entity id,
+    // use: Get<Type>(ent)
+    template<typename T> T* Get(EntityID id)
+    {
+        return static_cast<T*>(
+            GetRaw(GetEntityIndex(id), GetId<T>()));
+    }
+
+    // Removes a component from an entity ID
+    template<typename T> void Remove(EntityID id)
+    {
+        RemoveRaw(id, GetId<T>());
     }
 
     // Destroys an entity, resets its mask, adds the given entity's
     // index to the list of free entities
     void DestroyEntity(EntityID id)
     {
+        EntityIndex index = GetEntityIndex(id);
+        if (entities[index].id != id)
+            return;
+
+        if (storage == StorageMode::Archetype)
+        {
+            RemoveFromArchetype(index);
+        }
+        else
+        {
+            // Give the pool slots back so empty pages get freed
+            for (int i = 0; i < MAX_COMPONENTS; i++)
+            {
+                if (entities[index].mask.test(i))
+                {
+                    componentPools[i]->release(index);
+                }
+            }
+        }
+
+        ComponentMask oldMask = entities[index].mask;
+
         EntityID newID =
             CreateEntityId(EntityIndex(-1), GetEntityVersion(id) + 1);
-        entities[GetEntityIndex(id)].id = newID;
-        entities[GetEntityIndex(id)].mask.reset();
-        freeEntities.push_back(GetEntityIndex(id));
+        entities[index].id = newID;
+        entities[index].mask.reset();
+        freeEntities.push_back(index);
+
+        if (storage == StorageMode::Sparse)
+        {
+            UpdateQueries(index, oldMask, true);
+        }
+    }
+
+    // Destroys a batch of entities, the ids get sorted so that
+    // archetype scenes remove rows from the back of each archetype
+    // (nothing that's about to go gets moved) and sparse scenes walk
+    // the pools in order. Stale and repeated ids are skipped
+    void DestroyEntities(EntityID* ids, size_t count)
+    {
+        if (storage == StorageMode::Archetype)
+        {
+            auto key = [this](EntityID id)
+            {
+                EntityIndex index = GetEntityIndex(id);
+                if (index >= entities.size() ||
+                    entities[index].id != id)
+                    return std::pair<int, size_t>(-1, 0);
+                return std::pair<int, size_t>(
+                    entities[index].archetype, entities[index].row);
+            };
+
+            std::sort(ids, ids + count,
+                      [&](EntityID a, EntityID b)
+                      {
+                          auto keyA = key(a);
+                          auto keyB = key(b);
+                          if (keyA.first != keyB.first)
+                              return keyA.first < keyB.first;
+                          return keyA.second > keyB.second;
+                      });
+        }
+        else
+        {
+            std::sort(ids, ids + count);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (GetEntityIndex(ids[i]) < entities.size())
+            {
+                DestroyEntity(ids[i]);
+            }
+        }
     }
 
     // Clears all entities
@@ -223,6 +786,16 @@ struct Scene
         // Clean up component pools
         for (ComponentPool* pool : componentPools) { delete pool; }
         componentPools.clear();
+
+        // Clean up archetypes
+        for (Archetype* archetype : archetypes) { delete archetype; }
+        archetypes.clear();
+        archetypeLookup.clear();
+
+        componentSizes.clear();
+
+        // Queries stay registered but don't match anything anymore
+        for (SceneQuery* query : queries) { query->Reset(); }
     }
 
     EntityID CloneEntity(EntityID sourceId)
@@ -237,11 +810,40 @@ struct Scene
 
         // Create new entity
         EntityID newId = AddEntity();
+        if (newId == INVALID_ENTITY)
+        {
+            return INVALID_ENTITY;
+        }
 
         // Get the component mask of the source entity
-        const ComponentMask& sourceMask =
+        const ComponentMask sourceMask =
             entities[GetEntityIndex(sourceId)].mask;
 
+        if (storage == StorageMode::Archetype)
+        {
+            // Move the clone into the source's archetype, then copy
+            // every column over
+            MoveToArchetype(GetEntityIndex(newId), sourceMask);
+
+            const EntityDesc& source =
+                entities[GetEntityIndex(sourceId)];
+            const EntityDesc& dest = entities[GetEntityIndex(newId)];
+            Archetype*        archetype = archetypes[source.archetype];
+
+            for (int column = 0;
+                 column < (int)archetype->componentIds.size();
+                 column++)
+            {
+                std::memcpy(archetype->Get(dest.row, column),
+                            archetype->Get(source.row, column),
+                            archetype->componentSizes[column]);
+                archetype->Ticks(dest.row, column) = {CurrentTick(),
+                                                      CurrentTick()};
+            }
+
+            return newId;
+        }
+
         // For each set bit in the mask (each component)
         for (size_t i = 0; i < MAX_COMPONENTS; i++)
         {
@@ -259,11 +861,13 @@ struct Scene
                     char* sourceComponent = static_cast<char*>(
                         pool->get(GetEntityIndex(sourceId)));
                     char* destComponent = static_cast<char*>(
-                        pool->get(GetEntityIndex(newId)));
+                        pool->acquire(GetEntityIndex(newId)));
 
                     // Copy the component data
                     std::memcpy(destComponent, sourceComponent,
                                 pool->elementSize);
+                    pool->ticks(GetEntityIndex(newId)) = {
+                        CurrentTick(), CurrentTick()};
 
                     // Set the component bit for the new entity
                     entities[GetEntityIndex(newId)].mask.set(i);
@@ -271,23 +875,414 @@ struct Scene
             }
         }
 
+        UpdateQueries(GetEntityIndex(newId), ComponentMask(), true);
+
         return newId;
     }
 
+    // Finds the archetype with the given mask, creating it if it
+    // doesn't exist yet
+    int GetOrCreateArchetype(const ComponentMask& mask)
+    {
+        auto it = archetypeLookup.find(mask);
+        if (it != archetypeLookup.end())
+        {
+            return it->second;
+        }
+
+        if (componentSizes.size() < MAX_COMPONENTS)
+        {
+            componentSizes.resize(MAX_COMPONENTS, 0);
+        }
+
+        int index = (int)archetypes.size();
+        archetypes.push_back(new Archetype(mask, componentSizes));
+        archetypeLookup[mask] = index;
+
+        // Hand the new archetype to every query that wants it
+        for (SceneQuery* query : queries)
+        {
+            if (query->Matches(mask))
+            {
+                query->archetypes.push_back(archetypes.back());
+            }
+        }
+
+        return index;
+    }
+
+    // Moves an entity into the archetype for a new mask, keeping
+    // every component the two archetypes share
+    void MoveToArchetype(EntityIndex index, const ComponentMask& newMask)
+    {
+        int target = GetOrCreateArchetype(newMask);
+        if (target == entities[index].archetype)
+        {
+            entities[index].mask = newMask;
+            return;
+        }
+
+        Archetype* from = archetypes[entities[index].archetype];
+        Archetype* to = archetypes[target];
+
+        size_t newRow = to->Push(entities[index].id);
+        size_t oldRow = entities[index].row;
+
+        for (int column = 0; column < (int)to->componentIds.size();
+             column++)
+        {
+            int fromColumn = from->columnOf[to->componentIds[column]];
+            if (fromColumn >= 0)
+            {
+                std::memcpy(to->Get(newRow, column),
+                            from->Get(oldRow, fromColumn),
+                            to->componentSizes[column]);
+                to->Ticks(newRow, column) =
+                    from->Ticks(oldRow, fromColumn);
+            }
+        }
+
+        RemoveFromArchetype(index);
+
+        entities[index].archetype = target;
+        entities[index].row = newRow;
+        entities[index].mask = newMask;
+    }
+
+    // Takes an entity out of its archetype, the entity that fills the
+    // hole gets its row updated
+    void RemoveFromArchetype(EntityIndex index)
+    {
+        Archetype* archetype = archetypes[entities[index].archetype];
+        EntityID   moved = archetype->SwapRemove(entities[index].row);
+
+        if (moved != INVALID_ENTITY)
+        {
+            entities[GetEntityIndex(moved)].row = entities[index].row;
+        }
+
+        entities[index].archetype = -1;
+    }
+
+    // Collects every archetype that has all of the components in the
+    // mask
+    void CollectArchetypes(const ComponentMask&     mask,
+                           std::vector<Archetype*>& out)
+    {
+        for (Archetype* archetype : archetypes)
+        {
+            if (mask == (mask & archetype->mask))
+            {
+                out.push_back(archetype);
+            }
+        }
+    }
+
+    // Creates a query for a mask, the scene owns it and keeps it up to
+    // date until RemoveQuery is called
+    SceneQuery* AddQuery(const ComponentMask& mask)
+    {
+        SceneQuery* query = new SceneQuery();
+        query->mask = mask;
+
+        if (storage == StorageMode::Archetype)
+        {
+            CollectArchetypes(mask, query->archetypes);
+        }
+        else
+        {
+            for (const EntityDesc& desc : entities)
+            {
+                if (IsEntityValid(desc.id) && query->Matches(desc.mask))
+                {
+                    query->AddMatch(desc.id);
+                }
+            }
+        }
+
+        queries.push_back(query);
+        return query;
+    }
+
+    void RemoveQuery(SceneQuery* query)
+    {
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            if (queries[i] == query)
+            {
+                queries.erase(queries.begin() + i);
+                break;
+            }
+        }
+        delete query;
+    }
+
+    // Sparse storage, adds or removes an entity from the queries after
+    // its mask changed
+    void UpdateQueries(EntityIndex          index,
+                       const ComponentMask& oldMask, bool wasAlive)
+    {
+        bool alive = IsEntityValid(entities[index].id);
+
+        for (SceneQuery* query : queries)
+        {
+            bool matched = wasAlive && query->Matches(oldMask);
+            bool matches =
+                alive && query->Matches(entities[index].mask);
+
+            if (matched && !matches)
+            {
+                query->RemoveMatch(index);
+            }
+            else if (!matched && matches)
+            {
+                query->AddMatch(entities[index].id);
+            }
+        }
+    }
+
+    StorageMode                 storage {StorageMode::Sparse};
+    size_t                      entityBudget {DEFAULT_ENTITY_BUDGET};
     std::vector<EntityDesc>     entities;
     std::vector<EntityIndex>    freeEntities;
     std::vector<ComponentPool*> componentPools;
+    std::vector<size_t>         componentSizes;
+    std::vector<Archetype*>     archetypes;
+    std::unordered_map<ComponentMask, int> archetypeLookup;
+    std::vector<SceneQuery*>               queries;
+    // Goes up every time a query starts a pass, component writes are
+    // stamped with it so queries can tell what changed since their
+    // last pass
+    std::atomic<uint32_t> changeTick {1};
 };
 
 struct skECSState;
 
 using SysFunc = void (*)(skECSState*);
 
+// What a system reads and writes, ids are the external component type
+// ids. Systems that don't declare their access may touch anything so
+// they run on the main thread with nothing else running next to them
+struct SystemDesc
+{
+    SysFunc             function {nullptr};
+    std::vector<size_t> reads;
+    std::vector<size_t> writes;
+    bool                declared {false};
+    // Has to run on the main thread, for example to read input
+    bool mainThread {false};
+};
+
+// Two systems conflict when one writes something the other one reads
+// or writes, conflicting systems run in the order they were added
+inline bool SystemsConflict(const SystemDesc& a, const SystemDesc& b)
+{
+    if (!a.declared || !b.declared)
+        return true;
+
+    auto overlaps =
+        [](const std::vector<size_t>& x, const std::vector<size_t>& y)
+    {
+        for (size_t id : x)
+        {
+            for (size_t other : y)
+            {
+                if (id == other)
+                    return true;
+            }
+        }
+        return false;
+    };
+
+    return overlaps(a.writes, b.writes) ||
+           overlaps(a.writes, b.reads) || overlaps(a.reads, b.writes);
+}
+
+// Runs the update systems as a dependency graph on the job system,
+// every system waits for the earlier systems it conflicts with and
+// the rest run at the same time
+class SystemScheduler
+{
+  public:
+    void Add(const SystemDesc& desc)
+    {
+        systems.push_back(desc);
+        dirty = true;
+    }
+
+    // The next run calls every system in order on the main thread.
+    // Systems create their queries lazily on their first run, this
+    // way that never happens while other systems read the scene
+    void RunSerially() { serial = true; }
+
+    // True while systems run next to each other
+    bool RunningInParallel() const
+    {
+        return running.load(std::memory_order_relaxed);
+    }
+
+    void Run(skECSState* state)
+    {
+        if (dirty)
+        {
+            Build();
+        }
+
+        // Nothing can run next to anything else, skip the job system
+        if (!parallel || serial)
+        {
+            for (auto& system : systems) { system.function(state); }
+            serial = false;
+            return;
+        }
+
+        running.store(true, std::memory_order_relaxed);
+        currentState = state;
+        finished.store(0);
+        for (size_t i = 0; i < systems.size(); i++)
+        {
+            remaining[i].store(dependencyCounts[i]);
+        }
+
+        for (int root : roots) { Dispatch(root); }
+
+        // The main thread runs the main thread systems and helps with
+        // the others until everything is done
+        int count = (int)systems.size();
+        while (finished.load(std::memory_order_acquire) < count)
+        {
+            int index = -1;
+            {
+                std::lock_guard<std::mutex> lock(mainMutex);
+                if (!mainQueue.empty())
+                {
+                    index = mainQueue.front();
+                    mainQueue.pop_front();
+                }
+            }
+
+            if (index >= 0)
+            {
+                RunSystem(&nodes[index]);
+            }
+            else if (!jobSystem.RunOne(currentWorker))
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        running.store(false, std::memory_order_relaxed);
+    }
+
+    std::vector<SystemDesc> systems;
+
+  private:
+    struct Node
+    {
+        SystemScheduler* scheduler;
+        int              index;
+    };
+
+    // Builds the graph, only happens when systems are added
+    void Build()
+    {
+        size_t count = systems.size();
+        dependents.assign(count, {});
+        dependencyCounts.assign(count, 0);
+        roots.clear();
+        nodes.clear();
+        remaining = std::vector<std::atomic<int>>(count);
+        parallel = false;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            // Systems without declared access run on the main thread
+            if (!systems[i].declared)
+            {
+                systems[i].mainThread = true;
+            }
+
+            if (systems[i].declared && !systems[i].mainThread)
+            {
+                parallel = true;
+            }
+
+            for (size_t j = 0; j < i; j++)
+            {
+                if (SystemsConflict(systems[j], systems[i]))
+                {
+                    dependents[j].push_back((int)i);
+                    dependencyCounts[i]++;
+                }
+            }
+
+            if (dependencyCounts[i] == 0)
+            {
+                roots.push_back((int)i);
+            }
+
+            nodes.push_back({this, (int)i});
+        }
+
+        // New systems haven't made their queries yet
+        dirty = false;
+        serial = true;
+    }
+
+    void Dispatch(int index)
+    {
+        if (systems[index].mainThread)
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            mainQueue.push_back(index);
+            return;
+        }
+
+        jobSystem.Submit({RunSystem, &nodes[index], nullptr});
+    }
+
+    static void RunSystem(void* data)
+    {
+        Node*            node = (Node*)data;
+        SystemScheduler* scheduler = node->scheduler;
+
+        scheduler->systems[node->index].function(
+            scheduler->currentState);
+
+        // Systems that were waiting on this one can start once it
+        // was the last thing they waited on
+        for (int dependent : scheduler->dependents[node->index])
+        {
+            if (scheduler->remaining[dependent].fetch_sub(1) == 1)
+            {
+                scheduler->Dispatch(dependent);
+            }
+        }
+
+        scheduler->finished.fetch_add(1, std::memory_order_release);
+    }
+
+    std::vector<std::vector<int>> dependents;
+    std::vector<int>              dependencyCounts;
+    std::vector<int>              roots;
+    std::vector<Node>             nodes;
+    std::vector<std::atomic<int>> remaining;
+    std::atomic<int>              finished {0};
+    std::mutex                    mainMutex;
+    std::deque<int>               mainQueue;
+    skECSState*                   currentState {nullptr};
+    bool                          dirty {true};
+    bool                          parallel {false};
+    bool                          serial {true};
+    std::atomic<bool>             running {false};
+};
+
 // All the systems that are registered
-inline std::vector<SysFunc> systems;
+inline SystemScheduler      systemScheduler;
 inline std::vector<SysFunc> startSystems;
 
-// Adds a system to the list of systems
+// Adds a system to the list of systems, the system doesn't declare
+// what it touches so it runs alone
 inline void AddSystem(SysFunc sys, bool startSys)
 {
     if (startSys)
@@ -296,7 +1291,23 @@ inline void AddSystem(SysFunc sys, bool startSys)
     }
     else
     {
-        systems.push_back(sys);
+        SystemDesc desc;
+        desc.function = sys;
+        systemScheduler.Add(desc);
+    }
+}
+
+// Adds a system that declared what it reads and writes, start systems
+// only run once so they always run in order on the main thread
+inline void AddSystem(const SystemDesc& desc, bool startSys)
+{
+    if (startSys)
+    {
+        startSystems.push_back(desc.function);
+    }
+    else
+    {
+        systemScheduler.Add(desc);
     }
 }
 
@@ -304,7 +1315,7 @@ inline void AddSystem(SysFunc sys, bool startSys)
 // frame to update all the systems each frame
 inline void UpdateSystems(skECSState* state)
 {
-    for (auto system : systems) { system(state); }
+    systemScheduler.Run(state);
 }
 
 // Updates all the start systems, call this only on the start of the
@@ -336,6 +1347,13 @@ template<typename... ComponentTypes> struct SceneView
             for (int i = 1; i < (sizeof...(ComponentTypes) + 1); i++)
                 componentMask.set(componentIds[i]);
         }
+
+        // With archetype storage only the matching archetypes are
+        // visited
+        if (scene.storage == StorageMode::Archetype)
+        {
+            scene.CollectArchetypes(componentMask, archetypes);
+        }
     }
 
     struct Iterator
@@ -346,19 +1364,36 @@ template<typename... ComponentTypes> struct SceneView
         {
         }
 
+        Iterator(const std::vector<Archetype*>* pArchetypes,
+                 size_t archetype)
+           : pArchetypes(pArchetypes), archetype(archetype)
+        {
+            SkipEmptyArchetypes();
+        }
+
         EntityID operator*() const
         {
+            if (pArchetypes)
+                return (*pArchetypes)[archetype]->EntityAt(row);
+
             return pScene->entities[index].id;
         }
 
         bool operator==(const Iterator& other) const
         {
+            if (pArchetypes)
+                return archetype == other.archetype &&
+                       row == other.row;
+
             return index == other.index ||
                    index == pScene->entities.size();
         }
 
         bool operator!=(const Iterator& other) const
         {
+            if (pArchetypes)
+                return !(*this == other);
+
             return index != other.index &&
                    index != pScene->entities.size();
         }
@@ -373,8 +1408,25 @@ template<typename... ComponentTypes> struct SceneView
                  mask == (mask & pScene->entities[index].mask));
         }
 
+        void SkipEmptyArchetypes()
+        {
+            while (archetype < pArchetypes->size() &&
+                   row >= (*pArchetypes)[archetype]->count)
+            {
+                archetype++;
+                row = 0;
+            }
+        }
+
         Iterator& operator++()
         {
+            if (pArchetypes)
+            {
+                row++;
+                SkipEmptyArchetypes();
+                return *this;
+            }
+
             do {
                 index++;
             } while (index < pScene->entities.size() &&
@@ -382,14 +1434,24 @@ template<typename... ComponentTypes> struct SceneView
             return *this;
         }
 
-        EntityIndex   index;
-        Scene*        pScene;
+        EntityIndex   index {0};
+        Scene*        pScene {nullptr};
         ComponentMask mask;
         bool          all {false};
+
+        // Archetype storage
+        const std::vector<Archetype*>* pArchetypes {nullptr};
+        size_t                         archetype {0};
+        size_t                         row {0};
     };
 
     const Iterator begin() const
     {
+        if (pScene->storage == StorageMode::Archetype)
+        {
+            return Iterator(&archetypes, 0);
+        }
+
         int firstIndex = 0;
         while (
             firstIndex < pScene->entities.size() &&
@@ -404,13 +1466,19 @@ template<typename... ComponentTypes> struct SceneView
 
     const Iterator end() const
     {
+        if (pScene->storage == StorageMode::Archetype)
+        {
+            return Iterator(&archetypes, archetypes.size());
+        }
+
         return Iterator(pScene, EntityIndex(pScene->entities.size()),
                         componentMask, all);
     }
 
-    Scene*        pScene {nullptr};
-    ComponentMask componentMask;
-    bool          all {false};
+    Scene*                  pScene {nullptr};
+    ComponentMask           componentMask;
+    bool                    all {false};
+    std::vector<Archetype*> archetypes;
 };
 
 // Macro for registering systems outside the main function
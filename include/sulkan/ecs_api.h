@@ -13,15 +13,28 @@ typedef struct skScene_t*  skSceneHandle;
 typedef unsigned long long skEntityID;
 
 // Constants
-#define SK_ECS_MAX_COMPONENTS 200
-#define SK_ECS_MAX_ENTITIES   1000
-#define SK_ECS_INVALID_ENTITY ((skEntityID) - 1)
+#define SK_ECS_MAX_COMPONENTS         200
+#define SK_ECS_DEFAULT_ENTITY_BUDGET  (1 << 20)
+#define SK_ECS_INVALID_ENTITY         ((skEntityID) - 1)
+
+// How a scene stores its components, sparse scenes keep one pool per
+// component type, archetype scenes pack entities with the same
+// components together so iterating them is dense
+typedef enum skECSStorageMode
+{
+    skECSStorageMode_Sparse,
+    skECSStorageMode_Archetype
+} skECSStorageMode;
 
 // Scene management
 skSceneHandle skECS_CreateScene(void);
+skSceneHandle skECS_CreateSceneWithStorage(skECSStorageMode mode);
 void          skECS_DestroyScene(skSceneHandle scene);
 void          skECS_ClearScene(skSceneHandle scene);
 int           skECS_EntityCount(skSceneHandle scene);
+// Sets how many entities the scene may hold, skECS_AddEntity returns
+// SK_ECS_INVALID_ENTITY once it's used up
+void skECS_SetEntityBudget(skSceneHandle scene, size_t budget);
 
 // Entity management
 skEntityID skECS_AddEntity(skSceneHandle scene);
@@ -99,6 +112,36 @@ void skECS_AddSystem(skSystemFunction system,
 void skECS_UpdateSystems(skECSState* state);
 void skECS_StartStartSystems(skECSState* state);
 
+// What a system reads and writes. Update systems whose access doesn't
+// conflict run at the same time on the job system, systems that do
+// conflict run in the order they were added. A parallel system must
+// declare every component type it touches and can't add or destroy
+// entities or add or remove components. Shared state that isn't a
+// component can be declared with a type standing for it, like
+// skRenderObject for the renderer's objects. Systems added with
+// skECS_AddSystem run alone on the main thread
+typedef struct skECSSystemAccess
+{
+    const skComponentTypeID* reads;
+    int                      readCount;
+    const skComponentTypeID* writes;
+    int                      writeCount;
+    // The system has to run on the main thread, for example because
+    // it reads input
+    bool mainThread;
+} skECSSystemAccess;
+
+void skECS_AddSystemWithAccess(skSystemFunction  system,
+                               bool              isStartSystem,
+                               skECSSystemAccess access);
+
+// Helper macro for filling in the reads or writes of an access, it
+// expands to the array and its count
+#define SK_ECS_TYPES(...)                                     \
+    (const skComponentTypeID[]) {__VA_ARGS__},                \
+        (int)(sizeof((skComponentTypeID[]) {__VA_ARGS__}) /   \
+              sizeof(skComponentTypeID))
+
 // Entity iteration
 typedef struct skEntityIterator_t* skEntityIteratorHandle;
 
@@ -131,6 +174,177 @@ void skECS_DestroyEntityIterator(skEntityIteratorHandle iterator);
     }                                   \
     while (0)
 
+// Cached queries, create one once (for example the first time a
+// system runs) and the scene keeps its list of matching entities up
+// to date as components are added and removed, so iterating it costs
+// no allocations, no hashing and no scan over every entity.
+// Don't add or remove components of the queried types while
+// iterating a query.
+typedef struct skECSQuery_t* skECSQuery;
+
+typedef struct skECSQueryIterator
+{
+    skECSQuery query;
+    size_t     group;
+    size_t     index;
+} skECSQueryIterator;
+
+skECSQuery skECS_CreateQuery(skSceneHandle            scene,
+                             const skComponentTypeID* componentTypeIds,
+                             int                      componentCount);
+void       skECS_DestroyQuery(skECSQuery query);
+// Scene the query was created for, NULL once that scene is destroyed
+// so the query has to be destroyed and made again
+skSceneHandle skECS_QueryScene(skECSQuery query);
+// Amount of entities that currently match the query
+size_t skECS_QueryCount(skECSQuery query);
+skECSQueryIterator skECS_QueryBegin(skECSQuery query);
+skEntityID         skECS_QueryNext(skECSQueryIterator* iterator);
+// Gets the component at termIndex (the order the types were passed to
+// skECS_CreateQuery in) without looking the component type up
+void* skECS_QueryGetComponent(skECSQuery query, skEntityID entity,
+                              int termIndex);
+
+// Called by skECS_ParallelForEach with a range of matching entities,
+// thread is the job system thread running the range (see
+// skJobSystem_CurrentThread) so results can be kept per thread.
+// Scratch from skJobSystem_ScratchAlloc is freed when this returns
+typedef void (*skECSForEachFunction)(skECSQuery        query,
+                                     const skEntityID* entities,
+                                     size_t count, int thread,
+                                     void* userdata);
+
+// Splits the entities matching the query into ranges of at most
+// grainSize entities (0 picks a size from the entity and thread
+// count) and runs them on the job system, the calling thread helps
+// and returns once every range is done. The callback can't add or
+// destroy entities or add or remove components, and the same query
+// can't be used by two ParallelForEach calls at once
+void skECS_ParallelForEach(skECSQuery query, skECSForEachFunction fn,
+                           void* userdata, size_t grainSize);
+
+#define SK_ECS_QUERY_GET(query, entity, termIndex, component_type) \
+    ((component_type*)skECS_QueryGetComponent(query, entity,       \
+                                              termIndex))
+
+// Change detection, every component remembers when it was added and
+// when it was last written. Writes through skECS_AssignComponent,
+// skECS_QueryGetComponentMut and skECS_MarkChanged count, writes
+// through plain pointers from SK_ECS_GET or SK_ECS_QUERY_GET don't.
+// "Since the last pass" means since the last skECS_QueryBegin or
+// skECS_ParallelForEach on the same query. Writes the query made with
+// skECS_QueryGetComponentMut during that pass don't count, so a system
+// can write the component it filters on
+typedef enum skECSQueryFilter
+{
+    skECSQueryFilter_None,
+    // Only entities whose component was written since the last pass
+    skECSQueryFilter_Changed,
+    // Only entities that got the component since the last pass
+    skECSQueryFilter_Added
+} skECSQueryFilter;
+
+// Filters a term of the query, an entity is visited if any of the
+// filtered terms pass
+void skECS_QuerySetFilter(skECSQuery query, int termIndex,
+                          skECSQueryFilter filter);
+// Checks a term of an entity against the query's current pass,
+// without having to filter the whole query
+bool skECS_QueryChanged(skECSQuery query, skEntityID entity,
+                        int termIndex);
+bool skECS_QueryAdded(skECSQuery query, skEntityID entity,
+                      int termIndex);
+// Like skECS_QueryGetComponent but marks the component as changed
+void* skECS_QueryGetComponentMut(skECSQuery query, skEntityID entity,
+                                 int termIndex);
+void  skECS_MarkChanged(skSceneHandle scene, skEntityID entity,
+                        skComponentTypeID componentTypeId);
+
+#define SK_ECS_QUERY_GET_MUT(query, entity, termIndex,          \
+                             component_type)                    \
+    ((component_type*)skECS_QueryGetComponentMut(query, entity, \
+                                                 termIndex))
+
+#define SK_ECS_MARK_CHANGED(scene, entity, component_type) \
+    skECS_MarkChanged(scene, entity,                       \
+                      SK_ECS_COMPONENT_TYPE(component_type))
+
+// Helper macro for creating a query once, the query is stored in the
+// variable passed in and is recreated if the scene changes. Systems
+// run alone on their first update and after a scene is created, use
+// it on every run so the query is made then
+#define SK_ECS_QUERY(query, scene, ...)                               \
+    do {                                                              \
+        if (query == NULL || skECS_QueryScene(query) != (scene))      \
+        {                                                             \
+            skComponentTypeID _queryTypes[] = {__VA_ARGS__};          \
+            if (query != NULL)                                        \
+                skECS_DestroyQuery(query);                            \
+            query = skECS_CreateQuery(                                \
+                scene, _queryTypes,                                   \
+                sizeof(_queryTypes) / sizeof(_queryTypes[0]));        \
+        }                                                             \
+    } while (0)
+
+// Helper macros for iterating a query, works like SK_ECS_ITER_START
+#define SK_ECS_QUERY_START(query)                                \
+    do {                                                         \
+        skECSQueryIterator _queryIter = skECS_QueryBegin(query); \
+        skEntityID         _entity;                              \
+        while ((_entity = skECS_QueryNext(&_queryIter)) !=       \
+               SK_ECS_INVALID_ENTITY)                            \
+        {
+
+#define SK_ECS_QUERY_END() \
+    }                      \
+    }                      \
+    while (0)
+
+// Command buffers record structural changes (spawning and destroying
+// entities, adding and removing components) so systems can make them
+// while iterating, parallel systems included, and apply them all at
+// once later with skECS_PlaybackCommandBuffer. Every job system
+// thread records into its own list so recording never locks, record
+// from the main thread or from jobs
+typedef struct skECSCommandBuffer_t* skECSCommandBuffer;
+
+skECSCommandBuffer skECS_CreateCommandBuffer(skSceneHandle scene);
+void skECS_DestroyCommandBuffer(skECSCommandBuffer buffer);
+
+// Returns a placeholder id for an entity that's created on playback,
+// until then it can only be passed to this buffer's functions
+skEntityID skECS_CommandSpawn(skECSCommandBuffer buffer);
+void skECS_CommandDestroy(skECSCommandBuffer buffer,
+                          skEntityID         entity);
+// Returns memory to fill the component in, it's copied into the
+// entity on playback. The memory starts out zeroed
+void* skECS_CommandAssign(skECSCommandBuffer buffer, skEntityID entity,
+                          skComponentTypeID componentTypeId,
+                          size_t            componentSize);
+void  skECS_CommandRemove(skECSCommandBuffer buffer, skEntityID entity,
+                          skComponentTypeID componentTypeId);
+
+// Applies everything that was recorded and empties the buffer. Spawned
+// entities are created with all of their components at once, then
+// components are added and removed on existing entities in the order
+// they were recorded (per thread), and last all destroyed entities
+// are removed in one batch. Call it while no systems are running
+void skECS_PlaybackCommandBuffer(skECSCommandBuffer buffer);
+
+// The real id of a placeholder from skECS_CommandSpawn, valid from the
+// playback that created it until the next playback
+skEntityID skECS_CommandResolve(skECSCommandBuffer buffer,
+                                skEntityID         spawned);
+
+#define SK_ECS_COMMAND_ASSIGN(buffer, entity, component_type)  \
+    ((component_type*)skECS_CommandAssign(                     \
+        buffer, entity, SK_ECS_COMPONENT_TYPE(component_type), \
+        sizeof(component_type)))
+
+#define SK_ECS_COMMAND_REMOVE(buffer, entity, component_type) \
+    skECS_CommandRemove(buffer, entity,                       \
+                        SK_ECS_COMPONENT_TYPE(component_type))
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <sulkan/string_id.h>
+#include <sulkan/job_system.h>
+
+// The decoded RGBA pixels of an image file, shared by everything that
+// uses the file like skModelAsset does with models. Released images
+// stay until skImageAsset_Collect. Only use from the main thread
+typedef struct skImageAsset
+{
+    unsigned char* pixels; // NULL if the file couldn't be decoded
+    int            width;
+    int            height;
+    skStringID     path;
+    int            refCount;
+    skJobGroup*    loading; // Until the decode is waited for
+} skImageAsset;
+
+// Returns the image for the path, decoding it the first time
+skImageAsset* skImageAsset_Acquire(const char* path);
+// Same, but a first decode runs on the job system and the pixels
+// can't be used before skImageAsset_Wait
+skImageAsset* skImageAsset_AcquireAsync(const char* path);
+void          skImageAsset_Wait(skImageAsset* image);
+void          skImageAsset_Release(skImageAsset* image);
+// Frees every image that isn't acquired
+void skImageAsset_Collect(void);
@@ -0,0 +1,64 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+// The job system runs work on a pool of worker threads, the main
+// thread helps running jobs while it waits for them. It starts by
+// itself the first time it's used with one worker for every core
+// except the main thread's.
+
+// Starts the job system with the given number of worker threads, a
+// negative count picks one per core and 0 runs everything on the main
+// thread. Only call this while no jobs are running
+void skJobSystem_Init(int workerCount);
+void skJobSystem_Shutdown(void);
+
+// The number of threads that run jobs, counting the main thread
+int skJobSystem_ThreadCount(void);
+
+// The index of the calling thread, 0 for the main thread and 1 to
+// skJobSystem_ThreadCount() - 1 for the workers
+int skJobSystem_CurrentThread(void);
+
+// Scratch memory for the calling thread, it stays valid until the job
+// that asked for it ends (for skECS_ParallelForEach that's the end of
+// the range being processed). Allocations are aligned to 16 bytes
+void* skJobSystem_ScratchAlloc(size_t size);
+
+// Called by skJobSystem_ParallelFor with the items [begin, end),
+// thread is the job system thread running them
+typedef void (*skJobRangeFunction)(void* userdata, size_t begin,
+                                   size_t end, int thread);
+
+// Splits count items into ranges of at most grainSize (0 picks a
+// size from the item and thread count) and runs them on the job
+// system, the calling thread helps and returns once every range is
+// done
+void skJobSystem_ParallelFor(size_t count, size_t grainSize,
+                             skJobRangeFunction fn, void* userdata);
+
+// Jobs started one by one that run while the caller goes on, it waits
+// for all of them at once when it needs their results
+typedef struct skJobGroup skJobGroup;
+
+typedef void (*skJobFunction)(void* userdata);
+
+skJobGroup* skJobGroup_Create(void);
+// Waits for the jobs still running before freeing the group
+void skJobGroup_Free(skJobGroup* group);
+
+// Queues fn to run on the job system as part of the group
+void skJobGroup_Run(skJobGroup* group, skJobFunction fn,
+                    void* userdata);
+
+// Helps running jobs until every job of the group is done
+void skJobGroup_Wait(skJobGroup* group);
+
+#ifdef __cplusplus
+}
+#endif
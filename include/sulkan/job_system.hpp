@@ -0,0 +1,336 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// A job is a function and the data passed to it, the counter (if
+// there is one) is decremented once the job has run so whoever
+// submitted it can wait for it
+struct Job
+{
+    void (*function)(void*) {nullptr};
+    void*             data {nullptr};
+    std::atomic<int>* counter {nullptr};
+};
+
+// Every thread has its own queue, the owner pushes and pops at the
+// back and the other threads steal from the front
+struct alignas(64) JobQueue
+{
+    std::mutex      mutex;
+    std::deque<Job> jobs;
+};
+
+// Scratch memory for one thread, handed out linearly. Whoever runs a
+// job marks the arena before and restores it after, the blocks are
+// kept around so once the arena is big enough it never allocates
+class ScratchArena
+{
+  public:
+    struct Marker
+    {
+        size_t block;
+        size_t used;
+    };
+
+    ~ScratchArena()
+    {
+        for (Block& block : blocks)
+        {
+            ::operator delete(block.pData, std::align_val_t(64));
+        }
+    }
+
+    void* Alloc(size_t size)
+    {
+        size = (size + 15) & ~(size_t)15;
+
+        if (blocks.empty())
+        {
+            AddBlock(size);
+            current = 0;
+            used = 0;
+        }
+        else if (used + size > blocks[current].size)
+        {
+            current++;
+            used = 0;
+
+            if (current == blocks.size())
+            {
+                AddBlock(size);
+            }
+            else if (blocks[current].size < size)
+            {
+                // A kept block that's too small, replace it
+                ::operator delete(blocks[current].pData,
+                                  std::align_val_t(64));
+                blocks[current] = NewBlock(size);
+            }
+        }
+
+        void* ptr = blocks[current].pData + used;
+        used += size;
+        return ptr;
+    }
+
+    Marker Mark() const { return {current, used}; }
+
+    // Frees everything allocated since the marker
+    void Restore(Marker marker)
+    {
+        current = marker.block;
+        used = marker.used;
+    }
+
+  private:
+    struct Block
+    {
+        char*  pData;
+        size_t size;
+    };
+
+    Block NewBlock(size_t minSize)
+    {
+        size_t size =
+            blocks.empty() ? 64 * 1024 : blocks.back().size * 2;
+        while (size < minSize) { size *= 2; }
+
+        return {(char*)::operator new(size, std::align_val_t(64)),
+                size};
+    }
+
+    void AddBlock(size_t minSize)
+    {
+        blocks.push_back(NewBlock(minSize));
+    }
+
+    std::vector<Block> blocks;
+    size_t             current {0};
+    size_t             used {0};
+};
+
+inline thread_local ScratchArena scratchArena;
+
+// The index of the thread inside the job system, 0 is the thread that
+// isn't a worker (the main thread), workers go from 1 to WorkerCount
+inline thread_local int currentWorker = 0;
+
+class JobSystem
+{
+  public:
+    ~JobSystem() { Stop(); }
+
+    // Starts the worker threads, a negative count uses one worker for
+    // every core except the main thread's, 0 runs every job on the
+    // thread that waits for it
+    void Start(int workerCount)
+    {
+        Stop();
+
+        if (workerCount < 0)
+        {
+            int cores = (int)std::thread::hardware_concurrency();
+            workerCount = cores > 1 ? cores - 1 : 0;
+        }
+
+        queueCount = workerCount + 1;
+        queues = std::make_unique<JobQueue[]>(queueCount);
+        stopping = false;
+
+        for (int i = 1; i < queueCount; i++)
+        {
+            workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+        }
+
+        started = true;
+    }
+
+    // Joins the worker threads, only call this while no jobs are
+    // queued
+    void Stop()
+    {
+        if (!started)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCondition.notify_all();
+
+        for (std::thread& worker : workers) { worker.join(); }
+
+        workers.clear();
+        queues.reset();
+        queueCount = 0;
+        started = false;
+    }
+
+    // Starts the workers the first time the job system is used
+    void EnsureStarted()
+    {
+        if (started.load(std::memory_order_acquire))
+            return;
+
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (!started)
+        {
+            Start(-1);
+        }
+    }
+
+    // The number of threads that run jobs, counting the main thread
+    int ThreadCount()
+    {
+        EnsureStarted();
+        return queueCount;
+    }
+
+    void Submit(const Job& job)
+    {
+        EnsureStarted();
+
+        int index = currentWorker < queueCount ? currentWorker : 0;
+        {
+            std::lock_guard<std::mutex> lock(queues[index].mutex);
+            queues[index].jobs.push_back(job);
+        }
+
+        pending.fetch_add(1);
+
+        // Only take the lock when someone could be asleep
+        if (sleeping.load() > 0)
+        {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            sleepCondition.notify_one();
+        }
+    }
+
+    // Queues a batch of jobs with a single lock and wakes everyone up
+    void SubmitBatch(const Job* jobs, size_t count)
+    {
+        EnsureStarted();
+
+        int index = currentWorker < queueCount ? currentWorker : 0;
+        {
+            std::lock_guard<std::mutex> lock(queues[index].mutex);
+            queues[index].jobs.insert(queues[index].jobs.end(), jobs,
+                                      jobs + count);
+        }
+
+        pending.fetch_add((int)count);
+
+        if (sleeping.load() > 0)
+        {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            sleepCondition.notify_all();
+        }
+    }
+
+    // Runs one job from the thread's own queue or stolen from another
+    // thread, returns false if there was nothing to run
+    bool RunOne(int worker)
+    {
+        Job job;
+        if (!Pop(worker, job) && !Steal(worker, job))
+            return false;
+
+        pending.fetch_sub(1);
+        job.function(job.data);
+
+        if (job.counter)
+        {
+            job.counter->fetch_sub(1, std::memory_order_release);
+        }
+
+        return true;
+    }
+
+    // Helps running jobs until the counter reaches 0
+    void Wait(std::atomic<int>& counter)
+    {
+        while (counter.load(std::memory_order_acquire) > 0)
+        {
+            if (!RunOne(currentWorker))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+  private:
+    bool Pop(int worker, Job& job)
+    {
+        if (worker >= queueCount)
+            worker = 0;
+
+        JobQueue&                   queue = queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            return false;
+
+        job = queue.jobs.back();
+        queue.jobs.pop_back();
+        return true;
+    }
+
+    bool Steal(int worker, Job& job)
+    {
+        for (int i = 1; i < queueCount; i++)
+        {
+            JobQueue& queue = queues[(worker + i) % queueCount];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty())
+                continue;
+
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    void WorkerLoop(int index)
+    {
+        currentWorker = index;
+
+        while (true)
+        {
+            if (RunOne(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1);
+            sleepCondition.wait(lock,
+                                [this] {
+                                    return pending.load() > 0 ||
+                                           stopping;
+                                });
+            sleeping.fetch_sub(1);
+
+            if (stopping && pending.load() == 0)
+                break;
+        }
+    }
+
+    std::unique_ptr<JobQueue[]> queues;
+    int                         queueCount {0};
+    std::vector<std::thread>    workers;
+    std::atomic<bool>           started {false};
+    std::mutex                  startMutex;
+    std::atomic<int>            pending {0};
+    std::atomic<int>            sleeping {0};
+    std::mutex                  sleepMutex;
+    std::condition_variable     sleepCondition;
+    bool                        stopping {false};
+};
+
+inline JobSystem jobSystem;
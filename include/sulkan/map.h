@@ -5,39 +5,45 @@
 #include <string.h>
 #include <stdint.h>
 
-// Hash map entry (node in the linked list)
-typedef struct skMapEntry
-{
-    void* key;
-    void* value;
-    struct skMapEntry* next;
-} skMapEntry;
-
 // Hash function pointer type
 typedef uint32_t (*skHashFunc)(const void* key, size_t keySize);
 
 // Key comparison function pointer type
 typedef int (*skKeyCompareFunc)(const void* key1, const void* key2, size_t keySize);
 
+// Slots are looked at in groups of this many control bytes at once
+#define SK_MAP_GROUP_SIZE 16
+
+// Open addressing hash map. Every slot has a control byte that says
+// whether it's empty, deleted or holds a key, in which case it's 7 bits
+// of the key's hash, so a lookup checks a whole group of slots with a
+// few instructions and only compares the keys whose bits match. Keys
+// and values are stored inline, next to each other
 typedef struct
 {
-    skMapEntry** buckets;    // Array of bucket heads
+    uint8_t* ctrl;           // Control byte of every slot
+    uint8_t* slots;          // Key and value of every slot
     size_t keySize;          // Size of key type
     size_t valueSize;        // Size of value type
-    size_t bucket_count;     // Number of buckets
+    size_t valueOffset;      // Offset of the value inside a slot
+    size_t slotSize;         // Size of a slot
+    size_t capacity;         // Number of slots, a power of 2
     size_t size;             // Number of elements in the map
+    size_t growthLeft;       // Inserts left before the map grows
     skHashFunc hash_func;    // Hash function
     skKeyCompareFunc cmp_func; // Key comparison function
 } skMap;
 
-// Initialize the map
+// Initialize the map, initial_bucket_count is how many elements it
+// should fit before growing (0 for the default)
 skMap* skMap_Create(size_t keySize, size_t valueSize, size_t initial_bucket_count,
                     skHashFunc hash_func, skKeyCompareFunc cmp_func);
 
 // Insert or update a key-value pair
 int skMap_Insert(skMap* map, const void* key, const void* value);
 
-// Get a value by key (returns pointer to value, or NULL if not found)
+// Get a value by key (returns pointer to value, or NULL if not found),
+// the pointer is valid until the next insert
 void* skMap_Get(skMap* map, const void* key);
 
 // Remove a key-value pair
@@ -49,6 +55,11 @@ int skMap_Contains(skMap* map, const void* key);
 // Get the number of elements in the map
 size_t skMap_Size(skMap* map);
 
+// The value in a slot, or NULL if the slot holds nothing. Going over
+// slots 0 to capacity visits every element, removing the current one
+// on the way doesn't move the others
+void* skMap_SlotValue(skMap* map, size_t slot);
+
 // Clear all elements from the map
 void skMap_Clear(skMap* map);
 
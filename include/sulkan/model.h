@@ -2,6 +2,8 @@
 
 #include <sulkan/vector.h>
 #include <sulkan/map.h>
+#include <sulkan/string_id.h>
+#include <sulkan/job_system.h>
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -13,10 +15,19 @@
 
 typedef struct skBoneInfo
 {
-    int  id;
-    mat4 offset;
+    int        id;
+    skStringID name;
+    mat4       offset;
 } skBoneInfo;
 
+// Box around the bind pose vertices a bone moves, in the bone's space
+// (after its offset matrix) so it stays tight however the bone turns
+typedef struct skBoneBounds
+{
+    vec3 box[2];    // Min and max, invalid if no vertex uses the bone
+    mat4 boneToMesh; // Inverse of the bone's offset matrix
+} skBoneBounds;
+
 typedef struct
 {
     vec3  position;
@@ -52,12 +63,18 @@ typedef struct
     char      directory[128];
     skVector* loadedTextures;  // skTexture
     skVector* meshes;          // skMesh
-    skMap*    boneInfoMap;     // char*, skBoneInfo
+    skMap*    boneInfoMap;     // skStringID, skBoneInfo
     int       boneCount;
+
+    // Found while reading the bone weights, boneBounds is indexed by
+    // bone ID. Vertices without bones go in unskinnedBounds
+    skVector* boneBounds; // skBoneBounds
+    vec3      unskinnedBounds[2];
 } skModel;
 
 skModel skModel_Create();
 void    skModel_Load(skModel* model, const char* path);
+void    skModel_Destroy(skModel* model);
 void    skModel_ProcessNode(skModel* model, struct aiNode* node,
                             const struct aiScene* scene);
 skMesh  skModel_ProcessMesh(skModel* model, struct aiMesh* mesh,
@@ -69,12 +86,44 @@ void    skModel_LoadMaterialTextures(skModel*              model,
                                      const struct aiScene* scene,
                                      skVector*             textures);
 void skSetVertexBoneDataToDefault(skVertex* vertex);
+// Adds an influence, keeping the SK_MAX_BONE_INFLUENCE heaviest
 void skSetVertexBoneData(skVertex* vertex, 
         int id, float weight);
+// Once every influence is in, scales the weights to add up to 1 and
+// points the unused slots of a skinned vertex at a bone with no weight
+void skNormalizeVertexBoneData(skVertex* vertex);
 void skModel_ExtractBoneWeightForVertices(skModel*       model,
                                           skVector*      vertices,
                                           struct aiMesh*        mesh,
                                           const struct aiScene* scene);
+// Box around the model posed with the bone matrices (an animator's
+// finalBoneMatrices), from the bones' boxes without skinning vertices
+void skModel_GetPoseBounds(skModel* model, const mat4* boneMatrices,
+                           int boneCount, vec3 dest[2]);
+
+// A model shared by everything that loads the same file. The registry
+// keeps it after the last release so a scene full of the same model
+// imports it once, skModelAsset_Collect then frees the ones nobody
+// holds once the meshes are on the GPU and the colliders are built.
+// Only use from the main thread
+typedef struct skModelAsset
+{
+    skModel     model;
+    skStringID  path; // Normalized
+    int         refCount;
+    skJobGroup* loading; // Until the load is waited for
+} skModelAsset;
+
+// Returns the model for the path, loading it the first time
+skModelAsset* skModelAsset_Acquire(const char* path);
+// Same, but a first load runs on the job system and the model can't
+// be used before skModelAsset_Wait. Start every load a scene needs
+// and then wait for them, so they all run at once
+skModelAsset* skModelAsset_AcquireAsync(const char* path);
+void          skModelAsset_Wait(skModelAsset* asset);
+void          skModelAsset_Release(skModelAsset* asset);
+// Frees every model that isn't acquired
+void skModelAsset_Collect(void);
 
 unsigned int skTextureFromFile(const char* path,
                                const char* directory);
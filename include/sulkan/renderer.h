@@ -12,11 +12,21 @@
 #include <sulkan/window.h>
 #include <cglm/cglm.h>
 #include <sulkan/model.h>
+#include <sulkan/image.h>
 #include <sulkan/ecs_api.h>
 
 #define SK_FRAMES_IN_FLIGHT   (2)
 #define SK_MAX_RENDER_OBJECTS (20)
 #define SK_MAX_BONES (100)
+// Bone palettes the bone buffers start with room for, they grow when
+// more skinned objects are drawn in a frame
+#define SK_BONE_PALETTES (16)
+
+typedef struct skStagingBuffer
+{
+    VkBuffer       buffer;
+    VkDeviceMemory memory;
+} skStagingBuffer;
 
 typedef struct skSwapchainDetails
 {
@@ -87,6 +97,10 @@ typedef struct skRenderObject
     skVector* boneTransforms; // mat4, not owned by this struct
 
     mat4 transform;
+
+    // The model matrix each frame's uniform buffer holds, objects
+    // that didn't move aren't uploaded again
+    mat4 uploadedTransforms[SK_FRAMES_IN_FLIGHT];
 } skRenderObject;
 
 typedef struct skLineObject
@@ -149,6 +163,10 @@ typedef struct skRenderer
     VkDeviceMemory           depthImageMemory;
     mat4                     viewTransform;
     vec3                     viewPos;
+    // The view and projection each frame's object uniform buffers
+    // hold, when they change every object is uploaded again
+    mat4                     uploadedView[SK_FRAMES_IN_FLIGHT];
+    mat4                     uploadedProj[SK_FRAMES_IN_FLIGHT];
     skVector*                renderObjects; // skRenderObject
     skVector*                lineObjects; // skLineObject
     skVector*                lights;        // skLight
@@ -160,16 +178,27 @@ typedef struct skRenderer
     VkDeviceMemory  storageBuffersMemory[SK_FRAMES_IN_FLIGHT];
     void*           storageBuffersMap[SK_FRAMES_IN_FLIGHT];
     
+    // Every skinned object drawn in a frame gets its own palette of
+    // SK_MAX_BONES matrices in the frame's bone buffer, which its
+    // draw picks with a dynamic offset
     VkDescriptorSet boneDescriptorSets[SK_FRAMES_IN_FLIGHT];
     VkBuffer        boneBuffers[SK_FRAMES_IN_FLIGHT];
     VkDeviceMemory  boneBuffersMemory[SK_FRAMES_IN_FLIGHT];
     void*           boneBuffersMap[SK_FRAMES_IN_FLIGHT];
+    u32             bonePaletteCapacity[SK_FRAMES_IN_FLIGHT];
+    VkDeviceSize    bonePaletteStride; // Aligned for dynamic offsets
 
     VkDescriptorSet uniformDescriptorSets[SK_FRAMES_IN_FLIGHT];
     VkBuffer        uniformBuffers[SK_FRAMES_IN_FLIGHT];
     VkDeviceMemory  uniformBuffersMemory[SK_FRAMES_IN_FLIGHT];
     void*           uniformBuffersMap[SK_FRAMES_IN_FLIGHT];
 
+    // While an upload batch is open the single time commands all go
+    // in this command buffer and the staging buffers they read from
+    // are kept until it has run
+    VkCommandBuffer uploadCommandBuffer;
+    skVector*       uploadStagingBuffers; // skStagingBuffer
+
     VkInstance instance;
 } skRenderer;
 
@@ -260,6 +289,15 @@ VkCommandBuffer
      skRenderer_BeginSingleTimeCommands(skRenderer* renderer);
 void skRenderer_EndSingleTimeCommands(skRenderer*     renderer,
                                       VkCommandBuffer commandBuffer);
+// Everything uploaded between these is submitted and waited on once
+// at the end instead of once per copy. Don't draw what they upload
+// before the batch ends
+void skRenderer_BeginUploads(skRenderer* renderer);
+void skRenderer_EndUploads(skRenderer* renderer);
+// Destroys the buffer once the uploads reading it are done
+void skRenderer_DestroyStagingBuffer(skRenderer*    renderer,
+                                     VkBuffer       buffer,
+                                     VkDeviceMemory memory);
 void skRenderer_CopyBuffer(skRenderer* renderer, VkBuffer srcBuffer,
                            VkBuffer dstBuffer, VkDeviceSize size);
 void skRenderer_CopyBufferToImage(skRenderer* renderer,
@@ -273,6 +311,9 @@ Bool skHasStencilComponent(VkFormat format);
 void skRenderer_CreateDescriptorSetLayout(skRenderer* renderer);
 void skRenderer_CreateDescriptorSets(skRenderer* renderer);
 void skRenderer_CreateDescriptorPool(skRenderer* renderer);
+// Makes room for count bone palettes in the current frame's bone
+// buffer, only call it once the frame's fence has been waited on
+void skRenderer_ReserveBonePalettes(skRenderer* renderer, u32 count);
 void skRenderer_Destroy(skRenderer* renderer);
 
 skRenderObject skRenderObject_CreateFromModel(
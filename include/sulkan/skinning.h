@@ -0,0 +1,49 @@
+#pragma once
+
+#include <sulkan/model.h>
+#include <sulkan/animation.h>
+
+// A mesh skinned on the CPU, for when there's no GPU to do it or to
+// check what the vertex shader does. The vertices are kept as one
+// array per component, padded to a multiple of 4 so the skinning
+// works on 4 vertices at a time
+typedef struct skSkinnedMesh
+{
+    int vertexCount;
+    int paddedCount;
+
+    // Bind pose
+    float* positions[3];
+    float* normals[3];
+
+    // Index into the palette and weight of every influence. Palette
+    // index 0 is the identity, used by vertices without bones, and
+    // bone i is at i + 1
+    int*   boneIDs[SK_MAX_BONE_INFLUENCE];
+    float* weights[SK_MAX_BONE_INFLUENCE];
+
+    // Written by skSkinnedMesh_Skin
+    float* skinnedPositions[3];
+    float* skinnedNormals[3];
+
+    mat4* palette;
+    int   paletteCount; // The highest bone ID used + 2
+
+    void* memory; // Every array above except the palette
+} skSkinnedMesh;
+
+skSkinnedMesh skSkinnedMesh_Create(const skMesh* mesh);
+void skSkinnedMesh_Free(skSkinnedMesh* mesh);
+
+// Deforms the bind pose with the bone matrices, split over the job
+// system. Bones the mesh uses past boneCount count as the identity
+void skSkinnedMesh_Skin(skSkinnedMesh* mesh, const mat4* boneMatrices,
+                        int boneCount);
+// Skins with the animator's finalBoneMatrices
+void skSkinnedMesh_SkinWithAnimator(skSkinnedMesh* mesh,
+                                    skAnimator*    animator);
+
+void skSkinnedMesh_GetPosition(const skSkinnedMesh* mesh, int vertex,
+                               vec3 dest);
+void skSkinnedMesh_GetNormal(const skSkinnedMesh* mesh, int vertex,
+                             vec3 dest);
@@ -0,0 +1,30 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+// Strings that get compared a lot (bone and node names) are interned
+// once when they're loaded and from then on compared and hashed as
+// small integers. The same string always gets the same ID for as long
+// as the program runs, 0 is never a valid ID
+typedef uint32_t skStringID;
+
+#define SK_STRING_ID_NONE ((skStringID)0)
+
+// Returns the string's ID, adding it to the table if it's new
+skStringID skStringID_Intern(const char* str);
+
+// Returns the string's ID, or SK_STRING_ID_NONE if it was never
+// interned, without adding it
+skStringID skStringID_Find(const char* str);
+
+// The interned copy of the string, it stays valid forever
+const char* skStringID_String(skStringID id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -10,5 +10,7 @@
 #include <sulkan/light_association.h>
 #include <sulkan/extra_systems.h>
 #include <sulkan/animation.h>
+#include <sulkan/skinning.h>
 #include <sulkan/physics_3d.h>
+#include <sulkan/transform.h>
 #include <sulkan/input.h>
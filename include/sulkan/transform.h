@@ -0,0 +1,31 @@
+#pragma once
+
+#include <sulkan/renderer.h>
+#include <sulkan/state.h>
+
+// Local transform of an entity, relative to its parent if it has a
+// skParent. skTransform_Sys only recomputes the world matrix of
+// transforms that were written with SK_ECS_QUERY_GET_MUT,
+// SK_ECS_MARK_CHANGED or assigned, and of their children
+typedef struct skTransform
+{
+    vec3 position;
+    vec4 rotation; // Quaternion
+    vec3 scale;
+
+    // Written by skTransform_Sys, copied to the render object if the
+    // entity has a skRenderAssociation
+    mat4 world;
+} skTransform;
+
+// Makes the entity's skTransform relative to the parent's, mark it
+// changed after changing the parent
+typedef struct skParent
+{
+    skEntityID parent;
+} skParent;
+
+// Keeps the entities with a skTransform sorted breadth first (parents
+// before children) and updates the world matrices of the dirty ones
+// a level at a time
+void skTransform_Sys(skECSState* state);
@@ -1,10 +1,16 @@
 #include <sulkan/animation.h>
+#include <sulkan/job_system.h>
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/matrix4x4.h>
 #include <assimp/vector3.h>
 
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define SK_ANIMATION_SSE
+#endif
+
 skAnimation skAnimation_Create(const struct aiAnimation* aiAnim,
                                const struct aiNode* rootNode,
                                skModel*    model)
@@ -23,6 +29,7 @@ skAnimation skAnimation_Create(const struct aiAnimation* aiAnim,
                                   rootNode);
 
     skAnimation_ReadMissingBones(&animation, aiAnim, model);
+    skAnimation_FlattenHierarchy(&animation);
 
     return animation;
 }
@@ -39,12 +46,7 @@ void skAnimation_Free(skAnimation* animation)
             skBone* bone = (skBone*)skVector_Get(animation->bones, i);
             if (bone)
             {
-                if (bone->positions)
-                    skVector_Free(bone->positions);
-                if (bone->rotations)
-                    skVector_Free(bone->rotations);
-                if (bone->scales)
-                    skVector_Free(bone->scales);
+                skBone_Free(bone);
             }
         }
         skVector_Free(animation->bones);
@@ -52,6 +54,19 @@ void skAnimation_Free(skAnimation* animation)
 
     skAssimpNodeData_Free(&animation->rootNode);
 
+    free(animation->nodeParents);
+    free(animation->nodeTransforms);
+    free(animation->nodeNames);
+    free(animation->nodePositions);
+    free(animation->nodeRotations);
+    free(animation->nodeScales);
+    free(animation->channelBones);
+    free(animation->channelNodes);
+    free(animation->channelSizes);
+    free(animation->skinNodes);
+    free(animation->skinBoneIds);
+    free(animation->skinOffsets);
+
     // boneInfoMap isn't freed here as it belongs to the model
 
     *animation = (skAnimation) {0};
@@ -59,21 +74,156 @@ void skAnimation_Free(skAnimation* animation)
 
 skBone* skAnimation_FindBone(skAnimation* animation, const char* name)
 {
-    if (!animation || !animation->bones || !name)
+    if (!name)
+        return NULL;
+
+    // A name that was never interned can't belong to a bone
+    skStringID nameId = skStringID_Find(name);
+    if (nameId == SK_STRING_ID_NONE)
+        return NULL;
+
+    return skAnimation_FindBoneByID(animation, nameId);
+}
+
+skBone* skAnimation_FindBoneByID(skAnimation* animation,
+                                 skStringID   nameId)
+{
+    if (!animation || !animation->bones)
         return NULL;
 
+    skBone* bones = (skBone*)animation->bones->data;
     for (size_t i = 0; i < animation->bones->size; i++)
     {
-        skBone* bone = (skBone*)skVector_Get(animation->bones, i);
-        if (bone && strcmp(bone->name, name) == 0)
+        if (bones[i].nameId == nameId)
         {
-            return bone;
+            return &bones[i];
         }
     }
 
     return NULL;
 }
 
+static int skAssimpNodeData_Count(const skAssimpNodeData* node)
+{
+    int count = 1;
+    for (int i = 0; i < node->childrenCount; i++)
+    {
+        count += skAssimpNodeData_Count(
+            (skAssimpNodeData*)skVector_Get(node->children, i));
+    }
+    return count;
+}
+
+static void skAnimation_FlattenNode(skAnimation*      animation,
+                                    skAssimpNodeData* node,
+                                    int               parent)
+{
+    int index = animation->nodeCount++;
+    animation->nodeParents[index] = parent;
+    glm_mat4_copy(node->transformation,
+                  animation->nodeTransforms[index]);
+    animation->nodeNames[index] = node->nameId;
+
+    mat4 rotation;
+    glm_decompose(node->transformation,
+                  animation->nodePositions[index], rotation,
+                  animation->nodeScales[index]);
+    glm_mat4_quat(rotation, animation->nodeRotations[index]);
+    animation->nodePositions[index][3] = 1.0f;
+    animation->nodeScales[index][3] = 1.0f;
+
+    skBone* bone = skAnimation_FindBoneByID(animation, node->nameId);
+    node->boneIndex =
+        bone ? (int)(bone - (skBone*)animation->bones->data) : -1;
+
+    if (bone)
+    {
+        animation->channelBones[animation->channelCount] =
+            node->boneIndex;
+        animation->channelNodes[animation->channelCount] = index;
+        animation->channelCount++;
+    }
+
+    skBoneInfo* info =
+        (skBoneInfo*)skMap_Get(animation->boneInfoMap, &node->nameId);
+
+    if (info)
+    {
+        animation->skinNodes[animation->skinCount] = index;
+        animation->skinBoneIds[animation->skinCount] = info->id;
+        glm_mat4_copy(info->offset,
+                      animation->skinOffsets[animation->skinCount]);
+        animation->skinCount++;
+    }
+
+    for (int i = 0; i < node->childrenCount; i++)
+    {
+        skAssimpNodeData* child =
+            (skAssimpNodeData*)skVector_Get(node->children, i);
+        skAnimation_FlattenNode(animation, child, index);
+    }
+}
+
+// Lays the node tree out depth first and resolves every node's bone
+// and bone info once, so computing a pose is a few linear loops
+void skAnimation_FlattenHierarchy(skAnimation* animation)
+{
+    int count = skAssimpNodeData_Count(&animation->rootNode);
+
+    animation->nodeParents = (int*)malloc(count * sizeof(int));
+    animation->nodeTransforms = (mat4*)malloc(count * sizeof(mat4));
+    animation->nodeNames =
+        (skStringID*)malloc(count * sizeof(skStringID));
+    animation->nodePositions = (vec4*)malloc(count * sizeof(vec4));
+    animation->nodeRotations = (vec4*)malloc(count * sizeof(vec4));
+    animation->nodeScales = (vec4*)malloc(count * sizeof(vec4));
+    animation->channelBones = (int*)malloc(count * sizeof(int));
+    animation->channelNodes = (int*)malloc(count * sizeof(int));
+    animation->skinNodes = (int*)malloc(count * sizeof(int));
+    animation->skinBoneIds = (int*)malloc(count * sizeof(int));
+    animation->skinOffsets = (mat4*)malloc(count * sizeof(mat4));
+
+    animation->nodeCount = 0;
+    animation->channelCount = 0;
+    animation->skinCount = 0;
+
+    skAnimation_FlattenNode(animation, &animation->rootNode, -1);
+
+    // Children come after their parents, so going backwards every
+    // node's reach is done before its parent's is extended by it
+    float* reach = (float*)calloc(count, sizeof(float));
+    for (int i = count - 1; i > 0; i--)
+    {
+        int   parent = animation->nodeParents[i];
+        float length =
+            reach[i] + glm_vec3_norm(animation->nodePositions[i]);
+        reach[parent] = glm_max(reach[parent], length);
+    }
+
+    // A leaf reaches nothing, its own offset still says how big it is
+    animation->channelSizes = (float*)malloc(count * sizeof(float));
+    for (int i = 0; i < animation->channelCount; i++)
+    {
+        int node = animation->channelNodes[i];
+        float length = glm_vec3_norm(animation->nodePositions[node]);
+        animation->channelSizes[i] = glm_max(reach[node], length);
+    }
+
+    free(reach);
+}
+
+void skAnimation_Compress(skAnimation*             animation,
+                          const skBoneCompression* compression)
+{
+    skBone* bones = (skBone*)animation->bones->data;
+    for (size_t i = 0; i < animation->bones->size; i++)
+    {
+        skBone_Compress(&bones[i], animation->duration,
+                        (float)animation->ticksPerSecond,
+                        compression);
+    }
+}
+
 void skAnimation_ReadMissingBones(skAnimation*              animation,
                                   const struct aiAnimation* aiAnim,
                                   skModel*                  model)
@@ -88,23 +238,24 @@ void skAnimation_ReadMissingBones(skAnimation*              animation,
     {
         const struct aiNodeAnim* channel = aiAnim->mChannels[i];
         const char* boneNamePtr = channel->mNodeName.data;
+        skStringID  boneName = skStringID_Intern(boneNamePtr);
 
         // Check if bone exists in model's bone info map
-        if (!skMap_Contains(model->boneInfoMap, &boneNamePtr))
+        if (!skMap_Contains(model->boneInfoMap, &boneName))
         {
             // Add new bone info to model's map
             skBoneInfo newBoneInfo;
             newBoneInfo.id = model->boneCount;
+            newBoneInfo.name = boneName;
             glm_mat4_identity(newBoneInfo.offset);
 
-            skMap_Insert(model->boneInfoMap, &boneNamePtr,
-                         &newBoneInfo);
+            skMap_Insert(model->boneInfoMap, &boneName, &newBoneInfo);
             model->boneCount++;
         }
 
         // Get bone info from map
         skBoneInfo* boneInfo =
-            (skBoneInfo*)skMap_Get(model->boneInfoMap, &boneNamePtr);
+            (skBoneInfo*)skMap_Get(model->boneInfoMap, &boneName);
 
         // Create bone object and add to animation
         skBone bone =
@@ -122,6 +273,8 @@ void skAnimation_ReadHierarchyData(skAssimpNodeData*    dest,
     // Copy node name
     strncpy(dest->name, src->mName.data, sizeof(dest->name) - 1);
     dest->name[sizeof(dest->name) - 1] = '\0';
+    dest->nameId = skStringID_Intern(dest->name);
+    dest->boneIndex = -1;
 
     // Convert Assimp matrix to CGLM matrix
     skAssimpMat4ToGLM(&src->mTransformation, dest->transformation);
@@ -180,63 +333,311 @@ int skAnimation_IsValid(skAnimation* animation)
            animation->bones->size > 0 && animation->duration > 0.0f;
 }
 
-skAnimator skAnimator_Create(skModel* model)
+skAnimationMask skAnimationMask_Create(skAnimation* animation,
+                                       float        weight)
 {
-    skAnimator anim = {0};
+    skAnimationMask mask = {0};
+    mask.count = animation->nodeCount;
+    mask.weights = (float*)malloc(mask.count * sizeof(float));
 
-    anim.currentTime = 0.0f;
+    for (int i = 0; i < mask.count; i++)
+    {
+        mask.weights[i] = weight;
+    }
 
-    anim.finalBoneMatrices = skVector_Create(sizeof(mat4), 100);
-    anim.animations = skVector_Create(sizeof(skAnimation), 1);
+    return mask;
+}
 
-    for (int i = 0; i < 100; i++)
+void skAnimationMask_Free(skAnimationMask* mask)
+{
+    free(mask->weights);
+    *mask = (skAnimationMask) {0};
+}
+
+void skAnimationMask_SetNode(skAnimationMask* mask,
+                             skAnimation*     animation,
+                             const char* name, float weight)
+{
+    skStringID nameId = skStringID_Find(name);
+
+    int node = 0;
+    while (node < animation->nodeCount &&
+           (nameId == SK_STRING_ID_NONE ||
+            animation->nodeNames[node] != nameId))
     {
-        mat4 ident = GLM_MAT4_IDENTITY_INIT;
-        skVector_PushBack(anim.finalBoneMatrices, &ident);
+        node++;
     }
 
+    if (node == animation->nodeCount)
+    {
+        printf("SK ERROR: No node called %s in the animation\n",
+               name);
+        return;
+    }
+
+    // Depth first, so the node's subtree is the nodes right after it
+    // whose parents are in the subtree
+    mask->weights[node] = weight;
+    for (int i = node + 1; i < animation->nodeCount &&
+                           animation->nodeParents[i] >= node;
+         i++)
+    {
+        mask->weights[i] = weight;
+    }
+}
+
+// skStringID, skAnimationLibrary*, the libraries in use by path
+static skMap* skAnimationLibrary_cache;
+
+// Imports the model file's clips into the library
+static void skAnimationLibrary_Load(skAnimationLibrary* library,
+                                    skModel*            model)
+{
     const struct aiScene* scene =
         aiImportFile(model->path, aiProcess_Triangulate);
-    
+
     if (!scene || !scene->mRootNode || !scene->mNumAnimations)
     {
         printf("SK ERROR: Failed to load animation file: %s\n",
                model->path);
-        return anim;
+        if (scene)
+            aiReleaseImport(scene);
+        return;
     }
 
-    for (int i = 0; i < scene->mNumAnimations; i++)
+    for (unsigned int i = 0; i < scene->mNumAnimations; i++)
     {
         const struct aiAnimation* aiAnim = scene->mAnimations[i];
 
-        skAnimation animation = skAnimation_Create(aiAnim, scene->mRootNode, model);
+        skAnimation animation =
+            skAnimation_Create(aiAnim, scene->mRootNode, model);
+
+        // The model can go away before the library does, everything
+        // needed from its bone info was copied while flattening
+        animation.boneInfoMap = NULL;
 
-        skVector_PushBack(anim.animations, &animation);
+        skVector_PushBack(library->animations, &animation);
     }
-    
-    skAnimation* firstAnim = (skAnimation*)skVector_Get(anim.animations, 0);
-    anim.currentAnimation = firstAnim;
-    
+
     aiReleaseImport(scene);
+}
+
+typedef struct skAnimationLibraryLoad
+{
+    skAnimationLibrary* library;
+    skModel*            model;
+} skAnimationLibraryLoad;
+
+static void skAnimationLibrary_LoadJob(void* userdata)
+{
+    skAnimationLibraryLoad* load = (skAnimationLibraryLoad*)userdata;
+    skAnimationLibrary_Load(load->library, load->model);
+    free(load);
+}
+
+static skAnimationLibrary* skAnimationLibrary_Get(skModel* model,
+                                                  bool     async)
+{
+    if (!skAnimationLibrary_cache)
+    {
+        skAnimationLibrary_cache = skMap_Create(
+            sizeof(skStringID), sizeof(skAnimationLibrary*), 16,
+            skMap_IntHash, skMap_IntCompare);
+    }
+
+    skStringID path = skStringID_Intern(model->path);
+
+    skAnimationLibrary** cached = (skAnimationLibrary**)skMap_Get(
+        skAnimationLibrary_cache, &path);
+    skAnimationLibrary* library = cached ? *cached : NULL;
+
+    if (!library)
+    {
+        library =
+            (skAnimationLibrary*)malloc(sizeof(skAnimationLibrary));
+        library->path = path;
+        library->refCount = 0;
+        library->animations = skVector_Create(sizeof(skAnimation), 4);
+        library->loading = NULL;
+        skMap_Insert(skAnimationLibrary_cache, &path, &library);
+
+        // Reading the clips adds the bones the model is missing, so
+        // the model is the job's until the load is waited for
+        if (async)
+        {
+            skAnimationLibraryLoad* load =
+                (skAnimationLibraryLoad*)malloc(
+                    sizeof(skAnimationLibraryLoad));
+            load->library = library;
+            load->model = model;
+
+            library->loading = skJobGroup_Create();
+            skJobGroup_Run(library->loading,
+                           skAnimationLibrary_LoadJob, load);
+        }
+        else
+        {
+            skAnimationLibrary_Load(library, model);
+        }
+    }
+
+    library->refCount++;
+    return library;
+}
+
+skAnimationLibrary* skAnimationLibrary_Acquire(skModel* model)
+{
+    skAnimationLibrary* library =
+        skAnimationLibrary_Get(model, false);
+    skAnimationLibrary_Wait(library);
+
+    if (library->animations->size == 0)
+    {
+        skAnimationLibrary_Release(library);
+        return NULL;
+    }
+
+    return library;
+}
+
+skAnimationLibrary* skAnimationLibrary_AcquireAsync(skModel* model)
+{
+    return skAnimationLibrary_Get(model, true);
+}
+
+void skAnimationLibrary_Wait(skAnimationLibrary* library)
+{
+    if (!library->loading)
+        return;
+
+    skJobGroup_Free(library->loading);
+    library->loading = NULL;
+}
+
+void skAnimationLibrary_Release(skAnimationLibrary* library)
+{
+    if (!library || --library->refCount > 0)
+        return;
+
+    skAnimationLibrary_Wait(library);
+
+    skMap_Remove(skAnimationLibrary_cache, &library->path);
+
+    for (size_t i = 0; i < library->animations->size; i++)
+    {
+        skAnimation_Free(
+            (skAnimation*)skVector_Get(library->animations, i));
+    }
+    skVector_Free(library->animations);
+    free(library);
+}
+
+skAnimator skAnimator_Create(skModel* model)
+{
+    skAnimator anim = {0};
+
+    anim.currentTime = 0.0f;
+    anim.lod = -1;
+    anim.lodFrame = -1;
+
+    anim.finalBoneMatrices = skVector_Create(sizeof(mat4), 100);
+
+    for (int i = 0; i < 100; i++)
+    {
+        mat4 ident = GLM_MAT4_IDENTITY_INIT;
+        skVector_PushBack(anim.finalBoneMatrices, &ident);
+    }
+
+    anim.library = skAnimationLibrary_Acquire(model);
+    if (!anim.library)
+    {
+        // Keep an empty list so the animator can still be used
+        anim.animations = skVector_Create(sizeof(skAnimation), 1);
+        return anim;
+    }
+
+    anim.animations = anim.library->animations;
+    anim.currentAnimation =
+        (skAnimation*)skVector_Get(anim.animations, 0);
 
     return anim;
 }
 
-void skAnimator_UpdateAnimation(skAnimator* animator, float dt)
+void skAnimator_Free(skAnimator* animator)
+{
+    if (animator->system)
+        skAnimationSystem_Remove(animator->system, animator);
+
+    if (animator->library)
+        skAnimationLibrary_Release(animator->library);
+    else if (animator->animations)
+        skVector_Free(animator->animations);
+
+    if (animator->finalBoneMatrices)
+        skVector_Free(animator->finalBoneMatrices);
+
+    for (int i = 0; i < SK_ANIMATOR_MAX_LAYERS; i++)
+    {
+        free(animator->layers[i].cursors);
+    }
+
+    free(animator->pose);
+    free(animator->localPose);
+    free(animator->cursors);
+    free(animator->previousCursors);
+    free(animator->blendPose);
+    free(animator->lodFrom);
+    free(animator->lodTo);
+
+    *animator = (skAnimator) {0};
+}
+
+static float skAnimation_Step(skAnimation* animation, float time,
+                              float dt)
+{
+    time += animation->ticksPerSecond * dt;
+    return fmod(time, animation->duration);
+}
+
+static void skAnimator_Advance(skAnimator* animator, float dt)
 {
     animator->deltaTime = dt;
-    if (animator->currentAnimation)
+    animator->currentTime = skAnimation_Step(
+        animator->currentAnimation, animator->currentTime, dt);
+
+    if (animator->previousAnimation)
     {
-        animator->currentTime +=
-            animator->currentAnimation->ticksPerSecond * dt;
+        animator->fadeTime += dt;
+        if (animator->fadeTime >= animator->fadeDuration)
+        {
+            animator->previousAnimation = NULL;
+        }
+        else
+        {
+            animator->previousTime =
+                skAnimation_Step(animator->previousAnimation,
+                                 animator->previousTime, dt);
+        }
+    }
 
-        animator->currentTime =
-            fmod(animator->currentTime,
-                 animator->currentAnimation->duration);
+    for (int i = 0; i < animator->layerCount; i++)
+    {
+        skAnimationLayer* layer = &animator->layers[i];
+        layer->currentTime = skAnimation_Step(
+            layer->animation, layer->currentTime, dt);
+    }
+}
 
-        skAnimator_CalculateBoneTransform(
-            animator, &animator->currentAnimation->rootNode,
-            GLM_MAT4_IDENTITY);
+void skAnimator_UpdateAnimation(skAnimator* animator, float dt)
+{
+    if (animator->currentAnimation)
+    {
+        skAnimator_Advance(animator, dt);
+        skAnimator_CalculateBoneTransforms(animator);
+    }
+    else
+    {
+        animator->deltaTime = dt;
     }
 }
 
@@ -244,52 +645,811 @@ void skAnimator_PlayAnimation(skAnimator* animator, skAnimation* anim)
 {
     animator->currentAnimation = anim;
     animator->currentTime = 0.0f;
+    animator->previousAnimation = NULL;
+
+    if (animator->cursors)
+    {
+        memset(animator->cursors, 0,
+               animator->cursorCapacity * sizeof(skKeyCursor));
+    }
 }
 
-void skAnimator_CalculateBoneTransform(skAnimator*       animator,
-                                       skAssimpNodeData* node,
-                                       mat4 parentTransform)
+void skAnimator_CrossFade(skAnimator* animator, skAnimation* anim,
+                          float duration)
 {
-    skBone* bone =
-        skAnimation_FindBone(animator->currentAnimation, node->name);
+    if (!animator->currentAnimation || duration <= 0.0f)
+    {
+        skAnimator_PlayAnimation(animator, anim);
+        return;
+    }
 
-    mat4 nodeTransform;
-    glm_mat4_copy(node->transformation, nodeTransform);
+    // What's playing becomes the one fading out, if something was
+    // already fading out it's dropped. The cursor buffers are swapped
+    // so nothing is allocated
+    animator->previousAnimation = animator->currentAnimation;
+    animator->previousTime = animator->currentTime;
+    animator->fadeTime = 0.0f;
+    animator->fadeDuration = duration;
 
-    if (bone)
+    skKeyCursor* cursors = animator->previousCursors;
+    int          capacity = animator->previousCursorCapacity;
+    animator->previousCursors = animator->cursors;
+    animator->previousCursorCapacity = animator->cursorCapacity;
+    animator->cursors = cursors;
+    animator->cursorCapacity = capacity;
+
+    animator->currentAnimation = anim;
+    animator->currentTime = 0.0f;
+
+    if (animator->cursors)
+    {
+        memset(animator->cursors, 0,
+               animator->cursorCapacity * sizeof(skKeyCursor));
+    }
+}
+
+int skAnimator_AddLayer(skAnimator* animator, skAnimation* anim,
+                        skAnimationBlendMode   mode,
+                        const skAnimationMask* mask, float weight)
+{
+    if (animator->layerCount == SK_ANIMATOR_MAX_LAYERS)
     {
-        skBone_Update(bone, animator->currentTime);
-        glm_mat4_copy(bone->localTransform, nodeTransform);
+        printf("SK ERROR: Animator already has %d layers\n",
+               SK_ANIMATOR_MAX_LAYERS);
+        return -1;
     }
 
-    mat4 globalTransformation;
-    glm_mat4_mul(parentTransform, nodeTransform,
-                 globalTransformation);
+    if (mask && mask->count != anim->nodeCount)
+    {
+        printf("SK ERROR: Animation mask is for another skeleton\n");
+        return -1;
+    }
 
-    const char* nodeName = &node->name;
+    // Keep the slot's cursors from a removed layer
+    skAnimationLayer* layer = &animator->layers[animator->layerCount];
+    layer->animation = anim;
+    layer->mask = mask;
+    layer->mode = mode;
+    layer->weight = weight;
+    layer->currentTime = 0.0f;
 
-    if (skMap_Contains(animator->currentAnimation->boneInfoMap,
-                       &nodeName))
+    if (layer->cursors)
     {
-        skBoneInfo* info = (skBoneInfo*)skMap_Get(
-            animator->currentAnimation->boneInfoMap, &nodeName);
+        memset(layer->cursors, 0,
+               layer->cursorCapacity * sizeof(skKeyCursor));
+    }
 
-        int index = info->id;
+    return animator->layerCount++;
+}
+
+void skAnimator_SetLayerWeight(skAnimator* animator, int layer,
+                               float weight)
+{
+    if (layer < 0 || layer >= animator->layerCount)
+        return;
 
-        mat4 bruhMat;
-        glm_mat4_mul(globalTransformation, info->offset, bruhMat);
+    animator->layers[layer].weight = glm_clamp(weight, 0.0f, 1.0f);
+}
+
+void skAnimator_RemoveLayer(skAnimator* animator, int layer)
+{
+    if (layer < 0 || layer >= animator->layerCount)
+        return;
+
+    // Move the removed layer to the end with its cursors so the slot
+    // can be reused
+    skAnimationLayer removed = animator->layers[layer];
+    memmove(&animator->layers[layer], &animator->layers[layer + 1],
+            (animator->layerCount - layer - 1) *
+                sizeof(skAnimationLayer));
+
+    animator->layerCount--;
+    removed.animation = NULL;
+    removed.mask = NULL;
+    animator->layers[animator->layerCount] = removed;
+}
+
+static void skKeyCursor_Reserve(skKeyCursor** cursors, int* capacity,
+                                int count)
+{
+    if (count <= *capacity)
+        return;
+
+    *cursors = (skKeyCursor*)realloc(*cursors,
+                                     count * sizeof(skKeyCursor));
+    memset(*cursors + *capacity, 0,
+           (count - *capacity) * sizeof(skKeyCursor));
+    *capacity = count;
+}
+
+// Local translations, rotations and scales of every node at time
+static void skAnimation_SamplePose(skAnimation* animation, float time,
+                                   skKeyCursor* cursors,
+                                   float        minBoneSize,
+                                   vec4* positions, vec4* rotations,
+                                   vec4* scales)
+{
+    size_t size = animation->nodeCount * sizeof(vec4);
+    memcpy(positions, animation->nodePositions, size);
+    memcpy(rotations, animation->nodeRotations, size);
+    memcpy(scales, animation->nodeScales, size);
+
+    skBone* bones = (skBone*)animation->bones->data;
+    for (int i = 0; i < animation->channelCount; i++)
+    {
+        if (animation->channelSizes[i] < minBoneSize)
+            continue;
 
-        mat4* boneMat =
-            (mat4*)skVector_Get(animator->finalBoneMatrices, index);
-        glm_mat4_copy(bruhMat, *boneMat);
+        int boneIndex = animation->channelBones[i];
+        int node = animation->channelNodes[i];
+        skBone_Sample(&bones[boneIndex], time, &cursors[boneIndex],
+                      positions[node], rotations[node], scales[node]);
     }
+}
 
-    for (int i = 0; i < node->childrenCount; i++)
+#ifdef SK_ANIMATION_SSE
+// The dot product of a and b in every lane
+static inline __m128 skAnimation_Dot4(__m128 a, __m128 b)
+{
+    __m128 dot = _mm_mul_ps(a, b);
+    dot = _mm_add_ps(
+        dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(
+        dot, _mm_shuffle_ps(dot, dot, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+#endif
+
+// Moves every node weight of the way toward the source pose, times
+// the node's mask weight if there's a mask. Rotations are normalized
+// lerps along the shorter way
+static void skAnimation_BlendOverride(vec4*        positions,
+                                      vec4*        rotations,
+                                      vec4*        scales,
+                                      const vec4*  srcPositions,
+                                      const vec4*  srcRotations,
+                                      const vec4*  srcScales,
+                                      int          count,
+                                      float        weight,
+                                      const float* mask)
+{
+    for (int i = 0; i < count; i++)
     {
-        skAssimpNodeData* nodeData =
-            (skAssimpNodeData*)skVector_Get(node->children, i);
+        float w = mask ? weight * mask[i] : weight;
+        if (w <= 0.0f)
+            continue;
+
+#ifdef SK_ANIMATION_SSE
+        __m128 vw = _mm_set1_ps(w);
+
+        __m128 p = _mm_loadu_ps(positions[i]);
+        __m128 src = _mm_loadu_ps(srcPositions[i]);
+        p = _mm_add_ps(p, _mm_mul_ps(_mm_sub_ps(src, p), vw));
+        _mm_storeu_ps(positions[i], p);
+
+        __m128 s = _mm_loadu_ps(scales[i]);
+        src = _mm_loadu_ps(srcScales[i]);
+        s = _mm_add_ps(s, _mm_mul_ps(_mm_sub_ps(src, s), vw));
+        _mm_storeu_ps(scales[i], s);
+
+        // The dot product's sign bit flips src onto r's side
+        __m128 r = _mm_loadu_ps(rotations[i]);
+        src = _mm_loadu_ps(srcRotations[i]);
+        __m128 dot = skAnimation_Dot4(r, src);
+        src = _mm_xor_ps(src, _mm_and_ps(dot, _mm_set1_ps(-0.0f)));
+
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(src, r), vw));
+        r = _mm_div_ps(r, _mm_sqrt_ps(skAnimation_Dot4(r, r)));
+        _mm_storeu_ps(rotations[i], r);
+#else
+        float sign = glm_vec4_dot((float*)rotations[i],
+                                  (float*)srcRotations[i]) < 0.0f
+                         ? -1.0f
+                         : 1.0f;
+
+        for (int c = 0; c < 4; c++)
+        {
+            positions[i][c] +=
+                (srcPositions[i][c] - positions[i][c]) * w;
+            scales[i][c] += (srcScales[i][c] - scales[i][c]) * w;
+            rotations[i][c] +=
+                (srcRotations[i][c] * sign - rotations[i][c]) * w;
+        }
+
+        glm_quat_normalize(rotations[i]);
+#endif
+    }
+}
+
+// Adds weight of how far the animation's channels are from its rest
+// pose. Nodes it doesn't animate are at rest so they're skipped
+static void skAnimation_BlendAdditive(skAnimation* animation,
+                                      vec4*        positions,
+                                      vec4*        rotations,
+                                      vec4*        scales,
+                                      const vec4*  srcPositions,
+                                      const vec4*  srcRotations,
+                                      const vec4*  srcScales,
+                                      float        weight,
+                                      const float* mask)
+{
+    for (int i = 0; i < animation->channelCount; i++)
+    {
+        int   node = animation->channelNodes[i];
+        float w = mask ? weight * mask[node] : weight;
+        if (w <= 0.0f)
+            continue;
+
+        for (int c = 0; c < 3; c++)
+        {
+            positions[node][c] +=
+                (srcPositions[node][c] -
+                 animation->nodePositions[node][c]) *
+                w;
+
+            float rest = animation->nodeScales[node][c];
+            if (rest != 0.0f)
+            {
+                scales[node][c] *=
+                    1.0f + (srcScales[node][c] / rest - 1.0f) * w;
+            }
+        }
+
+        vec4 restInverse, delta;
+        glm_quat_inv(animation->nodeRotations[node], restInverse);
+        glm_quat_mul((float*)srcRotations[node], restInverse, delta);
 
-        skAnimator_CalculateBoneTransform(animator, nodeData,
-                                          globalTransformation);
+        vec4 identity = GLM_QUAT_IDENTITY_INIT;
+        glm_quat_nlerp(identity, delta, w, delta);
+        glm_quat_mul(delta, rotations[node], rotations[node]);
     }
 }
+
+// Samples the current animation, the one fading out and the layers
+// into the blend buffers and writes the local node transforms to the
+// pose
+static void skAnimator_BlendLocalPose(skAnimator* animator,
+                                      float       minBoneSize)
+{
+    skAnimation* animation = animator->currentAnimation;
+    int          count = animation->nodeCount;
+
+    if (count > animator->blendCapacity)
+    {
+        animator->blendPose = (vec4*)realloc(
+            animator->blendPose, 6 * count * sizeof(vec4));
+        animator->blendCapacity = count;
+    }
+
+    vec4* positions = animator->blendPose;
+    vec4* rotations = positions + count;
+    vec4* scales = rotations + count;
+    vec4* srcPositions = scales + count;
+    vec4* srcRotations = srcPositions + count;
+    vec4* srcScales = srcRotations + count;
+
+    skAnimation_SamplePose(animation, animator->currentTime,
+                           animator->cursors, minBoneSize, positions,
+                           rotations, scales);
+
+    skAnimation* previous = animator->previousAnimation;
+    if (previous && previous->nodeCount == count)
+    {
+        skKeyCursor_Reserve(&animator->previousCursors,
+                            &animator->previousCursorCapacity,
+                            (int)previous->bones->size);
+        skAnimation_SamplePose(previous, animator->previousTime,
+                               animator->previousCursors, minBoneSize,
+                               srcPositions, srcRotations, srcScales);
+
+        // The one fading out starts at full weight and drops to none
+        float fade = animator->fadeTime / animator->fadeDuration;
+        skAnimation_BlendOverride(positions, rotations, scales,
+                                  srcPositions, srcRotations,
+                                  srcScales, count, 1.0f - fade,
+                                  NULL);
+    }
+
+    for (int i = 0; i < animator->layerCount; i++)
+    {
+        skAnimationLayer* layer = &animator->layers[i];
+        if (layer->weight <= 0.0f ||
+            layer->animation->nodeCount != count)
+        {
+            continue;
+        }
+
+        skKeyCursor_Reserve(&layer->cursors, &layer->cursorCapacity,
+                            (int)layer->animation->bones->size);
+        skAnimation_SamplePose(layer->animation, layer->currentTime,
+                               layer->cursors, minBoneSize,
+                               srcPositions, srcRotations, srcScales);
+
+        const float* mask = layer->mask ? layer->mask->weights : NULL;
+        if (layer->mode == skAnimationBlendMode_Additive)
+        {
+            skAnimation_BlendAdditive(layer->animation, positions,
+                                      rotations, scales, srcPositions,
+                                      srcRotations, srcScales,
+                                      layer->weight, mask);
+        }
+        else
+        {
+            skAnimation_BlendOverride(positions, rotations, scales,
+                                      srcPositions, srcRotations,
+                                      srcScales, count, layer->weight,
+                                      mask);
+        }
+    }
+
+    // Only now turn the blended pose into matrices
+    for (int i = 0; i < count; i++)
+    {
+        mat4* local = &animator->pose[i];
+        glm_quat_mat4(rotations[i], *local);
+        glm_scale(*local, scales[i]);
+        glm_vec3_copy(positions[i], (*local)[3]);
+    }
+}
+
+// Computes the pose into the animator's buffers and writes the final
+// bone matrices to finalMatrices
+static void skAnimator_Evaluate(skAnimator* animator,
+                                mat4* finalMatrices, int finalCount)
+{
+    skAnimation* animation = animator->currentAnimation;
+
+    if (animation->nodeCount > animator->poseCapacity)
+    {
+        size_t size = animation->nodeCount * sizeof(mat4);
+        animator->pose = (mat4*)realloc(animator->pose, size);
+        animator->localPose =
+            (mat4*)realloc(animator->localPose, size);
+        animator->poseCapacity = animation->nodeCount;
+
+        // Skipped before ever being evaluated they're at rest
+        memcpy(animator->localPose, animation->nodeTransforms, size);
+    }
+
+    skKeyCursor_Reserve(&animator->cursors, &animator->cursorCapacity,
+                        (int)animation->bones->size);
+
+    mat4* pose = animator->pose;
+    float minBoneSize =
+        animator->lod >= 0 ? animator->lods[animator->lod].minBoneSize
+                           : 0.0f;
+
+    if (animator->previousAnimation || animator->layerCount > 0)
+    {
+        skAnimator_BlendLocalPose(animator, minBoneSize);
+    }
+    else
+    {
+        // Start from the nodes' own transforms and replace the
+        // animated ones with the sampled bones
+        memcpy(pose, animation->nodeTransforms,
+               animation->nodeCount * sizeof(mat4));
+
+        skBone* bones = (skBone*)animation->bones->data;
+        for (int i = 0; i < animation->channelCount; i++)
+        {
+            if (animation->channelSizes[i] < minBoneSize)
+                continue;
+
+            int boneIndex = animation->channelBones[i];
+            skBone_Update(&bones[boneIndex], animator->currentTime,
+                          &animator->cursors[boneIndex],
+                          pose[animation->channelNodes[i]]);
+        }
+    }
+
+    // Channels the LOD skips hold the local transform they were last
+    // evaluated at instead of snapping to rest, others save theirs
+    for (int i = 0; i < animation->channelCount; i++)
+    {
+        int node = animation->channelNodes[i];
+        if (animation->channelSizes[i] < minBoneSize)
+            glm_mat4_copy(animator->localPose[node], pose[node]);
+        else
+            glm_mat4_copy(pose[node], animator->localPose[node]);
+    }
+
+    // Parents come first so theirs is already in model space, the
+    // root's local transform is its model space one
+    for (int i = 1; i < animation->nodeCount; i++)
+    {
+        mat4 global;
+        glm_mat4_mul(pose[animation->nodeParents[i]], pose[i],
+                     global);
+        glm_mat4_copy(global, pose[i]);
+    }
+
+    for (int i = 0; i < animation->skinCount; i++)
+    {
+        int id = animation->skinBoneIds[i];
+        if (id < finalCount)
+        {
+            glm_mat4_mul(pose[animation->skinNodes[i]],
+                         animation->skinOffsets[i],
+                         finalMatrices[id]);
+        }
+    }
+}
+
+void skAnimator_CalculateBoneTransforms(skAnimator* animator)
+{
+    skAnimator_Evaluate(animator,
+                        (mat4*)animator->finalBoneMatrices->data,
+                        (int)animator->finalBoneMatrices->size);
+}
+
+bool skAnimator_AddLOD(skAnimator* animator, float distance,
+                       int frameInterval, float minBoneSize)
+{
+    if (animator->lodCount == SK_ANIMATOR_MAX_LODS)
+    {
+        printf("SK ERROR: Animator already has %d LODs\n",
+               SK_ANIMATOR_MAX_LODS);
+        return false;
+    }
+
+    skAnimationLOD* lod = &animator->lods[animator->lodCount++];
+    lod->distance = distance;
+    lod->frameInterval = frameInterval;
+    lod->minBoneSize = minBoneSize;
+    return true;
+}
+
+// Picks the level for the distance to the camera and returns its
+// frame interval
+static int skAnimator_SelectLOD(skAnimator* animator,
+                                const float* cameraPosition)
+{
+    int lod = -1;
+    if (cameraPosition)
+    {
+        float distance = glm_vec3_distance(animator->position,
+                                           (float*)cameraPosition);
+        while (lod + 1 < animator->lodCount &&
+               distance >= animator->lods[lod + 1].distance)
+        {
+            lod++;
+        }
+    }
+
+    int interval = lod >= 0 ? animator->lods[lod].frameInterval : 1;
+    int previous = animator->lod >= 0
+                       ? animator->lods[animator->lod].frameInterval
+                       : 1;
+    if (lod != animator->lod && interval != previous)
+        animator->lodFrame = -1;
+
+    animator->lod = lod;
+    return interval;
+}
+
+// Splits the bone matrices into a translation, a rotation and a scale
+// each, so poses blend without shrinking or shearing the bones
+static void skAnimator_StoreLODPose(mat4* matrices, vec4* dest,
+                                    int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        vec4* bone = dest + 3 * i;
+        mat4  rotation;
+        glm_decompose(matrices[i], bone[0], rotation, bone[2]);
+        glm_mat4_quat(rotation, bone[1]);
+    }
+}
+
+// Rebuilds the bone matrices t of the way from one stored pose to the
+// other
+static void skAnimator_BlendLODPose(vec4* from, vec4* to, float t,
+                                    mat4* dest, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        vec4* a = from + 3 * i;
+        vec4* b = to + 3 * i;
+        vec3   position, scale;
+        versor rotation;
+        glm_vec3_lerp(a[0], b[0], t, position);
+        glm_quat_slerp(a[1], b[1], t, rotation);
+        glm_vec3_lerp(a[2], b[2], t, scale);
+
+        glm_quat_mat4(rotation, dest[i]);
+        glm_scale(dest[i], scale);
+        glm_vec3_copy(position, dest[i][3]);
+    }
+}
+
+// Advances the animator and writes its bone matrices at its level of
+// detail
+static void skAnimator_Tick(skAnimator* animator, float dt,
+                            const float* cameraPosition,
+                            mat4* finalMatrices, int finalCount)
+{
+    skAnimator_Advance(animator, dt);
+
+    int interval = skAnimator_SelectLOD(animator, cameraPosition);
+    if (interval <= 1)
+    {
+        skAnimator_Evaluate(animator, finalMatrices, finalCount);
+        return;
+    }
+
+    if (finalCount > animator->lodCapacity)
+    {
+        size_t size = 3 * finalCount * sizeof(vec4);
+        animator->lodFrom = (vec4*)realloc(animator->lodFrom, size);
+        animator->lodTo = (vec4*)realloc(animator->lodTo, size);
+        animator->lodCapacity = finalCount;
+        animator->lodFrame = -1;
+    }
+
+    if (animator->lodFrame < 0)
+    {
+        // Only the skinned matrices get written, the rest are stored
+        // as they are. Spread the animators on the same interval over
+        // its frames instead of evaluating them all on the same one
+        skAnimator_Evaluate(animator, finalMatrices, finalCount);
+        skAnimator_StoreLODPose(finalMatrices, animator->lodTo,
+                                finalCount);
+        memcpy(animator->lodFrom, animator->lodTo,
+               3 * finalCount * sizeof(vec4));
+        animator->lodFrame =
+            (int)(((uintptr_t)animator >> 4) % (uintptr_t)interval);
+        return;
+    }
+
+    if (animator->lodFrame == 0)
+    {
+        vec4* from = animator->lodTo;
+        animator->lodTo = animator->lodFrom;
+        animator->lodFrom = from;
+
+        // The matrices are at the last pose now, so the ones that
+        // aren't skinned stay put
+        skAnimator_Evaluate(animator, finalMatrices, finalCount);
+        skAnimator_StoreLODPose(finalMatrices, animator->lodTo,
+                                finalCount);
+        animator->lodFrame = interval;
+    }
+
+    animator->lodFrame--;
+
+    float t = 1.0f - (float)animator->lodFrame / (float)interval;
+    skAnimator_BlendLODPose(animator->lodFrom, animator->lodTo, t,
+                            finalMatrices, finalCount);
+}
+
+void skAnimator_UpdateAnimationLOD(skAnimator* animator, float dt,
+                                   vec3 cameraPosition)
+{
+    if (!animator->currentAnimation)
+    {
+        animator->deltaTime = dt;
+        return;
+    }
+
+    skAnimator_Tick(animator, dt, cameraPosition,
+                    (mat4*)animator->finalBoneMatrices->data,
+                    (int)animator->finalBoneMatrices->size);
+}
+
+skAnimationSystem skAnimationSystem_Create(void)
+{
+    skAnimationSystem system = {0};
+    system.entries =
+        skVector_Create(sizeof(skAnimationSystemEntry), 16);
+    return system;
+}
+
+// Gives the animator its own matrices back with the pose it has in
+// the arena
+static void skAnimationSystem_Detach(skAnimator* animator)
+{
+    skVector* matrices = animator->finalBoneMatrices;
+    memcpy(animator->boneStorage, matrices->data,
+           matrices->size * sizeof(mat4));
+    matrices->data = animator->boneStorage;
+
+    animator->system = NULL;
+    animator->systemIndex = 0;
+    animator->boneStorage = NULL;
+}
+
+void skAnimationSystem_Destroy(skAnimationSystem* system)
+{
+    skAnimationSystemEntry* entries =
+        (skAnimationSystemEntry*)system->entries->data;
+
+    for (size_t i = 0; i < system->entries->size; i++)
+    {
+        skAnimationSystem_Detach(entries[i].animator);
+    }
+
+    skVector_Free(system->entries);
+    free(system->boneMatrices);
+    *system = (skAnimationSystem) {0};
+}
+
+// Points every animator's finalBoneMatrices at its range of the
+// arena, which moves when it grows
+static void skAnimationSystem_Bind(skAnimationSystem* system)
+{
+    skAnimationSystemEntry* entries =
+        (skAnimationSystemEntry*)system->entries->data;
+
+    for (size_t i = 0; i < system->entries->size; i++)
+    {
+        entries[i].animator->finalBoneMatrices->data =
+            (void**)(system->boneMatrices + entries[i].boneOffset);
+        entries[i].animator->systemIndex = i;
+    }
+}
+
+void skAnimationSystem_Add(skAnimationSystem* system,
+                           skAnimator*        animator)
+{
+    if (animator->system)
+    {
+        printf("SK ERROR: Animator is already in a system\n");
+        return;
+    }
+
+    // The new animator goes at the end of the arena so the ones
+    // already in it keep their poses where they are
+    skVector* matrices = animator->finalBoneMatrices;
+    size_t    boneCount = system->boneCount + matrices->size;
+    if (boneCount > system->boneCapacity)
+    {
+        size_t capacity = system->boneCapacity * 2;
+        if (capacity < boneCount)
+            capacity = boneCount;
+
+        system->boneMatrices = (mat4*)realloc(
+            system->boneMatrices, capacity * sizeof(mat4));
+        system->boneCapacity = capacity;
+    }
+
+    // Its range starts from the pose it already has
+    skAnimationSystemEntry entry = {animator, system->boneCount};
+    memcpy(system->boneMatrices + entry.boneOffset, matrices->data,
+           matrices->size * sizeof(mat4));
+    system->boneCount = boneCount;
+
+    animator->system = system;
+    animator->boneStorage = matrices->data;
+    skVector_PushBack(system->entries, &entry);
+    skAnimationSystem_Bind(system);
+}
+
+void skAnimationSystem_Remove(skAnimationSystem* system,
+                              skAnimator*        animator)
+{
+    if (animator->system != system)
+        return;
+
+    skAnimationSystemEntry* entries =
+        (skAnimationSystemEntry*)system->entries->data;
+    size_t index = animator->systemIndex;
+    size_t offset = entries[index].boneOffset;
+    size_t count = animator->finalBoneMatrices->size;
+
+    skAnimationSystem_Detach(animator);
+    skVector_Remove(system->entries, index);
+
+    // Close the gap, the ranges after it move down with their poses
+    memmove(system->boneMatrices + offset,
+            system->boneMatrices + offset + count,
+            (system->boneCount - offset - count) * sizeof(mat4));
+    system->boneCount -= count;
+
+    for (size_t i = 0; i < system->entries->size; i++)
+    {
+        if (entries[i].boneOffset > offset)
+            entries[i].boneOffset -= count;
+    }
+
+    skAnimationSystem_Bind(system);
+}
+
+mat4* skAnimationSystem_GetBoneMatrices(skAnimationSystem* system,
+                                        skAnimator*        animator)
+{
+    if (animator->system != system)
+        return NULL;
+
+    return (mat4*)animator->finalBoneMatrices->data;
+}
+
+// By clip, the clips of a library are next to each other in it so
+// animators on the same skeleton run together too
+static int skAnimationSystemEntry_Compare(const void* a,
+                                          const void* b)
+{
+    uintptr_t first = (uintptr_t)((const skAnimationSystemEntry*)a)
+                          ->animator->currentAnimation;
+    uintptr_t second = (uintptr_t)((const skAnimationSystemEntry*)b)
+                           ->animator->currentAnimation;
+
+    if (first != second)
+        return first < second ? -1 : 1;
+
+    return 0;
+}
+
+static void skAnimationSystem_UpdateRange(void*  userdata,
+                                          size_t begin, size_t end,
+                                          int thread)
+{
+    (void)thread;
+    skAnimationSystem*      system = (skAnimationSystem*)userdata;
+    skAnimationSystemEntry* entries =
+        (skAnimationSystemEntry*)system->entries->data;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        skAnimator* animator = entries[i].animator;
+        if (!animator->currentAnimation)
+            continue;
+
+        skAnimator_Tick(animator, system->deltaTime,
+                        system->camera ? system->camera->position
+                                       : NULL,
+                        (mat4*)animator->finalBoneMatrices->data,
+                        (int)animator->finalBoneMatrices->size);
+    }
+}
+
+// Sorts the animators by clip once one changed clips or was added and
+// lays the arena out in the new order, so animators on the same clip
+// also write next to each other. The arena is always in entry order
+static void skAnimationSystem_Sort(skAnimationSystem* system)
+{
+    skAnimationSystemEntry* entries =
+        (skAnimationSystemEntry*)system->entries->data;
+    size_t count = system->entries->size;
+
+    size_t sorted = 1;
+    while (sorted < count &&
+           skAnimationSystemEntry_Compare(&entries[sorted - 1],
+                                          &entries[sorted]) <= 0)
+    {
+        sorted++;
+    }
+    if (sorted == count)
+        return;
+
+    qsort(entries, count, sizeof(skAnimationSystemEntry),
+          skAnimationSystemEntry_Compare);
+
+    mat4*  arena = (mat4*)malloc(system->boneCapacity * sizeof(mat4));
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t boneCount =
+            entries[i].animator->finalBoneMatrices->size;
+        memcpy(arena + offset,
+               system->boneMatrices + entries[i].boneOffset,
+               boneCount * sizeof(mat4));
+        entries[i].boneOffset = offset;
+        offset += boneCount;
+    }
+
+    free(system->boneMatrices);
+    system->boneMatrices = arena;
+    skAnimationSystem_Bind(system);
+}
+
+void skAnimationSystem_Update(skAnimationSystem* system, float dt)
+{
+    if (system->entries->size == 0)
+        return;
+
+    skAnimationSystem_Sort(system);
+
+    system->deltaTime = dt;
+    skJobSystem_ParallelFor(system->entries->size, 0,
+                            skAnimationSystem_UpdateRange, system);
+}
@@ -11,99 +11,133 @@ skBone skBone_Create(const char* name, int ID,
     skBone bone = {0};
 
     strcpy(bone.name, name);
+    bone.nameId = skStringID_Intern(name);
     bone.ID = ID;
-    glm_mat4_identity(bone.localTransform);
 
     // Initialize all keyframes by acessing them through assimp
 
-    bone.positions = skVector_Create(sizeof(skKeyPosition), 5);
-    bone.rotations = skVector_Create(sizeof(skKeyRotation), 5);
-    bone.scales = skVector_Create(sizeof(skKeyScale), 5);
-
     bone.numPositions = channel->mNumPositionKeys;
+    bone.positionTimes =
+        (float*)malloc(bone.numPositions * sizeof(float));
+    bone.positionValues =
+        (vec3*)malloc(bone.numPositions * sizeof(vec3));
     for (int positionIndex = 0; positionIndex < bone.numPositions;
          ++positionIndex)
     {
         const struct aiVector3D aiPosition =
             channel->mPositionKeys[positionIndex].mValue;
-        float timeStamp = channel->mPositionKeys[positionIndex].mTime;
-        skKeyPosition data;
-        skAssimpVec3ToGLM(&aiPosition, data.position);
-        data.timeStamp = timeStamp;
-
-        skVector_PushBack(bone.positions, &data);
+        bone.positionTimes[positionIndex] =
+            (float)channel->mPositionKeys[positionIndex].mTime;
+        skAssimpVec3ToGLM(&aiPosition,
+                          bone.positionValues[positionIndex]);
     }
 
     bone.numRotations = channel->mNumRotationKeys;
+    bone.rotationTimes =
+        (float*)malloc(bone.numRotations * sizeof(float));
+    bone.rotationValues =
+        (vec4*)malloc(bone.numRotations * sizeof(vec4));
     for (int rotationIndex = 0; rotationIndex < bone.numRotations;
          ++rotationIndex)
     {
         const struct aiQuaternion aiOrientation =
             channel->mRotationKeys[rotationIndex].mValue;
-        float timeStamp = channel->mRotationKeys[rotationIndex].mTime;
-        skKeyRotation data;
-        data.rotation[0] = aiOrientation.x;
-        data.rotation[1] = aiOrientation.y;
-        data.rotation[2] = aiOrientation.z;
-        data.rotation[3] = aiOrientation.w;
-        data.timeStamp = timeStamp;
-
-        skVector_PushBack(bone.rotations, &data);
+        bone.rotationTimes[rotationIndex] =
+            (float)channel->mRotationKeys[rotationIndex].mTime;
+        bone.rotationValues[rotationIndex][0] = aiOrientation.x;
+        bone.rotationValues[rotationIndex][1] = aiOrientation.y;
+        bone.rotationValues[rotationIndex][2] = aiOrientation.z;
+        bone.rotationValues[rotationIndex][3] = aiOrientation.w;
     }
 
     bone.numScales = channel->mNumScalingKeys;
+    bone.scaleTimes = (float*)malloc(bone.numScales * sizeof(float));
+    bone.scaleValues = (vec3*)malloc(bone.numScales * sizeof(vec3));
     for (int keyIndex = 0; keyIndex < bone.numScales; ++keyIndex)
     {
         const struct aiVector3D scale =
             channel->mScalingKeys[keyIndex].mValue;
-        float      timeStamp = channel->mScalingKeys[keyIndex].mTime;
-        skKeyScale data;
-        skAssimpVec3ToGLM(&scale, data.scale);
-        data.timeStamp = timeStamp;
-
-        skVector_PushBack(bone.scales, &data);
+        bone.scaleTimes[keyIndex] =
+            (float)channel->mScalingKeys[keyIndex].mTime;
+        skAssimpVec3ToGLM(&scale, bone.scaleValues[keyIndex]);
     }
 
     return bone;
 }
 
-int skBone_GetPositionIndex(skBone* bone, float animationTime)
+void skBone_Free(skBone* bone)
 {
-    for (int index = 0; index < bone->numPositions - 1; ++index)
-    {
-        skKeyPosition* pos =
-            (skKeyPosition*)skVector_Get(bone->positions, index + 1);
-
-        if (animationTime < pos->timeStamp)
-            return index;
-    }
-    assert(0);
+    free(bone->positionTimes);
+    free(bone->positionValues);
+    free(bone->rotationTimes);
+    free(bone->rotationValues);
+    free(bone->scaleTimes);
+    free(bone->scaleValues);
+    free(bone->positionTrack.keys);
+    free(bone->rotationTrack.keys);
+    free(bone->scaleTrack.keys);
 }
 
-int skBone_GetRotationIndex(skBone* bone, float animationTime)
+int skBone_FindKey(const float* times, int count, float animationTime,
+                   int* cursor)
 {
-    for (int index = 0; index < bone->numRotations - 1; ++index)
+    int last = count - 2;
+    int index = *cursor;
+
+    // Playing forward moves at most a few keys per frame
+    if (index >= 0 && index <= last && animationTime >= times[index])
     {
-        skKeyRotation* rot =
-            (skKeyRotation*)skVector_Get(bone->rotations, index + 1);
+        for (int step = 0; step < 4; step++)
+        {
+            if (index == last || animationTime < times[index + 1])
+            {
+                *cursor = index;
+                return index;
+            }
+            index++;
+        }
+    }
 
-        if (animationTime < rot->timeStamp)
-            return index;
+    // The time jumped (a seek or the animation looped), find the
+    // first key after it
+    int low = 1;
+    int high = count - 1;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (times[mid] > animationTime)
+            high = mid;
+        else
+            low = mid + 1;
     }
-    assert(0);
+
+    index = low - 1;
+    if (index > last)
+        index = last;
+
+    *cursor = index;
+    return index;
 }
 
-int skBone_GetScaleIndex(skBone* bone, float animationTime)
+int skBone_GetPositionIndex(skBone* bone, float animationTime,
+                            skKeyCursor* cursor)
 {
-    for (int index = 0; index < bone->numScales - 1; ++index)
-    {
-        skKeyScale* scale =
-            (skKeyScale*)skVector_Get(bone->scales, index + 1);
+    return skBone_FindKey(bone->positionTimes, bone->numPositions,
+                          animationTime, &cursor->position);
+}
 
-        if (animationTime < scale->timeStamp)
-            return index;
-    }
-    assert(0);
+int skBone_GetRotationIndex(skBone* bone, float animationTime,
+                            skKeyCursor* cursor)
+{
+    return skBone_FindKey(bone->rotationTimes, bone->numRotations,
+                          animationTime, &cursor->rotation);
+}
+
+int skBone_GetScaleIndex(skBone* bone, float animationTime,
+                         skKeyCursor* cursor)
+{
+    return skBone_FindKey(bone->scaleTimes, bone->numScales,
+                          animationTime, &cursor->scale);
 }
 
 float skGetScaleFactor(float lastTimeStamp, float nextTimeStamp,
@@ -113,102 +147,501 @@ float skGetScaleFactor(float lastTimeStamp, float nextTimeStamp,
     float midWayLength = animationTime - lastTimeStamp;
     float framesDiff = nextTimeStamp - lastTimeStamp;
     scaleFactor = midWayLength / framesDiff;
-    return scaleFactor;
+    return glm_clamp(scaleFactor, 0.0f, 1.0f);
 }
 
-void skBone_InterpolatePosition(skBone* bone, float animationTime,
-                                mat4 dest)
+static void skBone_SamplePosition(skBone* bone,
+                                  float animationTime,
+                                  skKeyCursor* cursor, vec3 dest)
 {
     if (bone->numPositions == 1)
     {
-        skKeyPosition* pos =
-            (skKeyPosition*)skVector_Get(bone->positions, 0);
-        glm_translate(dest, pos->position);
+        glm_vec3_copy(bone->positionValues[0], dest);
         return;
     }
 
-    int p0Index = skBone_GetPositionIndex(bone, animationTime);
+    int p0Index =
+        skBone_GetPositionIndex(bone, animationTime, cursor);
     int p1Index = p0Index + 1;
 
-    skKeyPosition* key1 =
-        (skKeyPosition*)skVector_Get(bone->positions, p0Index);
-    skKeyPosition* key2 =
-        (skKeyPosition*)skVector_Get(bone->positions, p1Index);
-
     float scaleFactor = skGetScaleFactor(
-        key1->timeStamp, key2->timeStamp, animationTime);
-
-    vec3 finalPosition;
-    glm_vec3_mix(key1->position, key2->position, scaleFactor,
-                 finalPosition);
+        bone->positionTimes[p0Index], bone->positionTimes[p1Index],
+        animationTime);
 
-    glm_translate(dest, finalPosition);
+    glm_vec3_mix(bone->positionValues[p0Index],
+                  bone->positionValues[p1Index], scaleFactor, dest);
 }
 
-void skBone_InterpolateRotation(skBone* bone, float animationTime,
-                                mat4 dest)
+static void skBone_SampleRotation(skBone* bone,
+                                  float animationTime,
+                                  skKeyCursor* cursor, vec4 dest)
 {
     if (bone->numRotations == 1)
     {
-        skKeyRotation* rot =
-            (skKeyRotation*)skVector_Get(bone->rotations, 0);
-        glm_quat_mat4(rot->rotation, dest);
+        glm_vec4_copy(bone->rotationValues[0], dest);
         return;
     }
 
-    int p0Index = skBone_GetRotationIndex(bone, animationTime);
+    int p0Index =
+        skBone_GetRotationIndex(bone, animationTime, cursor);
     int p1Index = p0Index + 1;
 
-    skKeyRotation* key1 =
-        (skKeyRotation*)skVector_Get(bone->rotations, p0Index);
-    skKeyRotation* key2 =
-        (skKeyRotation*)skVector_Get(bone->rotations, p1Index);
-
     float scaleFactor = skGetScaleFactor(
-        key1->timeStamp, key2->timeStamp, animationTime);
-
-    vec4 finalRotation;
-    glm_quat_slerp(key1->rotation, key2->rotation, scaleFactor,
-                   finalRotation);
+        bone->rotationTimes[p0Index], bone->rotationTimes[p1Index],
+        animationTime);
 
-    glm_quat_mat4(finalRotation, dest);
+    glm_quat_slerp(bone->rotationValues[p0Index],
+                   bone->rotationValues[p1Index], scaleFactor, dest);
 }
 
-void skBone_InterpolateScale(skBone* bone, float animationTime,
-                             mat4 dest)
+static void skBone_SampleScale(skBone* bone, float animationTime,
+                               skKeyCursor* cursor, vec3 dest)
 {
     if (bone->numScales == 1)
     {
-        skKeyScale* scale =
-            (skKeyScale*)skVector_Get(bone->scales, 0);
-        glm_scale(dest, scale->scale);
+        glm_vec3_copy(bone->scaleValues[0], dest);
         return;
     }
 
-    int   p0Index = skBone_GetScaleIndex(bone, animationTime);
-    int   p1Index = p0Index + 1;
+    int p0Index = skBone_GetScaleIndex(bone, animationTime, cursor);
+    int p1Index = p0Index + 1;
+
     float scaleFactor = skGetScaleFactor(
-        ((skKeyScale*)skVector_Get(bone->scales, p0Index))->timeStamp,
-        ((skKeyScale*)skVector_Get(bone->scales, p1Index))->timeStamp,
+        bone->scaleTimes[p0Index], bone->scaleTimes[p1Index],
         animationTime);
 
-    vec3 finalScale;
-    glm_vec3_mix(
-        ((skKeyScale*)skVector_Get(bone->scales, p0Index))->scale,
-        ((skKeyScale*)skVector_Get(bone->scales, p1Index))->scale,
-        scaleFactor, finalScale);
+    glm_vec3_mix(bone->scaleValues[p0Index],
+                  bone->scaleValues[p1Index], scaleFactor, dest);
+}
 
+void skBone_InterpolatePosition(skBone* bone, float animationTime,
+                                skKeyCursor* cursor, mat4 dest)
+{
+    vec3 finalPosition;
+    skBone_SamplePosition(bone, animationTime, cursor, finalPosition);
+    glm_translate(dest, finalPosition);
+}
+
+void skBone_InterpolateRotation(skBone* bone, float animationTime,
+                                skKeyCursor* cursor, mat4 dest)
+{
+    vec4 finalRotation;
+    skBone_SampleRotation(bone, animationTime, cursor, finalRotation);
+    glm_quat_mat4(finalRotation, dest);
+}
+
+void skBone_InterpolateScale(skBone* bone, float animationTime,
+                             skKeyCursor* cursor, mat4 dest)
+{
+    vec3 finalScale;
+    skBone_SampleScale(bone, animationTime, cursor, finalScale);
     glm_scale(dest, finalScale);
 }
 
-void skBone_Update(skBone* bone, float animationTime)
+// Largest component of a smallest three quaternion is left out, the
+// other three are within +-1/sqrt(2)
+#define SK_BONE_QUAT_RANGE 0.70710678f
+
+static void skCompressedTrack_EncodeQuat(vec4 quat, uint16_t* key)
+{
+    vec4 q;
+    glm_quat_normalize_to(quat, q);
+
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+    {
+        if (fabsf(q[i]) > fabsf(q[largest]))
+            largest = i;
+    }
+
+    // q and -q are the same rotation, make the dropped one positive
+    float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+    uint64_t bits = (uint64_t)largest << 45;
+    int      shift = 30;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized =
+            (q[i] * sign / SK_BONE_QUAT_RANGE) * 0.5f + 0.5f;
+        uint64_t quantized =
+            (uint64_t)(glm_clamp(normalized, 0.0f, 1.0f) * 32767.0f +
+                       0.5f);
+        bits |= quantized << shift;
+        shift -= 15;
+    }
+
+    key[0] = (uint16_t)(bits >> 32);
+    key[1] = (uint16_t)(bits >> 16);
+    key[2] = (uint16_t)bits;
+}
+
+static void skCompressedTrack_DecodeQuat(const uint16_t* key,
+                                         vec4            dest)
+{
+    uint64_t bits = ((uint64_t)key[0] << 32) |
+                    ((uint64_t)key[1] << 16) | key[2];
+    int largest = (int)(bits >> 45) & 3;
+
+    float sum = 0.0f;
+    int   shift = 30;
+    for (int i = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized =
+            (float)((bits >> shift) & 0x7FFF) / 32767.0f;
+        dest[i] = (normalized * 2.0f - 1.0f) * SK_BONE_QUAT_RANGE;
+        sum += dest[i] * dest[i];
+        shift -= 15;
+    }
+
+    dest[largest] = sqrtf(fmaxf(0.0f, 1.0f - sum));
+}
+
+static void
+skCompressedTrack_DecodeVec3(const skCompressedTrack* track,
+                             const uint16_t* key, vec3 dest)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        dest[i] = track->rangeMin[i] +
+                  (float)key[i] / 65535.0f * track->rangeExtent[i];
+    }
+}
+
+// Biggest stride between kept samples that still rebuilds every
+// sample within the tolerance, 0 if the channel is constant. samples
+// holds intervals + 1 vec4s
+static int skBone_ReduceSamples(vec4* samples, int intervals,
+                                bool rotation, float tolerance)
+{
+    bool constant = true;
+    for (int i = 1; i <= intervals && constant; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            if (fabsf(samples[i][c] - samples[0][c]) > tolerance)
+                constant = false;
+        }
+    }
+
+    if (constant)
+        return 0;
+
+    int best = 1;
+    for (int stride = 2; stride <= intervals; stride++)
+    {
+        // Keys have to stay evenly spaced
+        if (intervals % stride != 0)
+            continue;
+
+        for (int i = 0; i <= intervals; i++)
+        {
+            int first = i / stride * stride;
+            if (first == intervals)
+                first -= stride;
+
+            float t = (float)(i - first) / (float)stride;
+            vec4  rebuilt;
+            if (rotation)
+            {
+                glm_quat_slerp(samples[first],
+                               samples[first + stride], t, rebuilt);
+                if (glm_vec4_dot(rebuilt, samples[i]) < 0.0f)
+                    glm_vec4_negate(rebuilt);
+            }
+            else
+            {
+                glm_vec4_lerp(samples[first], samples[first + stride],
+                              t, rebuilt);
+            }
+
+            for (int c = 0; c < 4; c++)
+            {
+                if (fabsf(rebuilt[c] - samples[i][c]) > tolerance)
+                    return best;
+            }
+        }
+
+        best = stride;
+    }
+
+    return best;
+}
+
+static void skBone_QuantizeTrack(skCompressedTrack* track,
+                                 vec4* samples, int intervals,
+                                 int stride, bool rotation)
+{
+    track->count = stride ? intervals / stride + 1 : 1;
+    stride = stride ? stride : 1;
+    track->keys =
+        (uint16_t*)malloc(track->count * 3 * sizeof(uint16_t));
+
+    if (rotation)
+    {
+        for (int k = 0; k < track->count; k++)
+        {
+            skCompressedTrack_EncodeQuat(samples[k * stride],
+                                         track->keys + k * 3);
+        }
+        return;
+    }
+
+    vec3 rangeMax;
+    glm_vec3_copy(samples[0], track->rangeMin);
+    glm_vec3_copy(samples[0], rangeMax);
+    for (int k = 1; k < track->count; k++)
+    {
+        glm_vec3_minv(track->rangeMin, samples[k * stride],
+                      track->rangeMin);
+        glm_vec3_maxv(rangeMax, samples[k * stride], rangeMax);
+    }
+    glm_vec3_sub(rangeMax, track->rangeMin, track->rangeExtent);
+
+    for (int k = 0; k < track->count; k++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            float extent = track->rangeExtent[c];
+            float normalized =
+                extent > 0.0f ? (samples[k * stride][c] -
+                                 track->rangeMin[c]) /
+                                    extent
+                              : 0.0f;
+            track->keys[k * 3 + c] =
+                (uint16_t)(glm_clamp(normalized, 0.0f, 1.0f) *
+                               65535.0f +
+                           0.5f);
+        }
+    }
+}
+
+typedef enum skBoneChannel
+{
+    skBoneChannel_Position,
+    skBoneChannel_Rotation,
+    skBoneChannel_Scale
+} skBoneChannel;
+
+static void
+skBone_CompressChannel(skBone* bone, skBoneChannel channel,
+                       const float* times, int count, float duration,
+                       float                    ticksPerSecond,
+                       const skBoneCompression* compression)
+{
+    // Keys that are already evenly spaced over the animation (the
+    // usual for baked exports) are kept where they are, anything else
+    // is resampled at SK_BONE_SAMPLE_RATE or the key count, whichever
+    // is more
+    bool uniform = count > 1 && fabsf(times[0]) < 1e-4f &&
+                   fabsf(times[count - 1] - duration) < 1e-3f;
+    for (int i = 1; i < count - 1 && uniform; i++)
+    {
+        float expected = duration * (float)i / (float)(count - 1);
+        uniform = fabsf(times[i] - expected) < 1e-3f;
+    }
+
+    int intervals = count - 1;
+    if (!uniform)
+    {
+        float wanted =
+            duration / ticksPerSecond * SK_BONE_SAMPLE_RATE;
+        intervals = (int)ceilf(fmaxf(wanted, (float)(count - 1)));
+    }
+    if (intervals < 1)
+        intervals = 1;
+
+    skKeyCursor cursor = {0};
+    vec4*       samples =
+        (vec4*)malloc((intervals + 1) * sizeof(vec4));
+
+    for (int i = 0; i <= intervals; i++)
+    {
+        float time = duration * (float)i / (float)intervals;
+        glm_vec4_zero(samples[i]);
+
+        if (channel == skBoneChannel_Position)
+        {
+            skBone_SamplePosition(bone, time, &cursor, samples[i]);
+        }
+        else if (channel == skBoneChannel_Scale)
+        {
+            skBone_SampleScale(bone, time, &cursor, samples[i]);
+        }
+        else
+        {
+            skBone_SampleRotation(bone, time, &cursor, samples[i]);
+            glm_quat_normalize(samples[i]);
+
+            // Keep neighbours on the same side so the tolerance check
+            // compares like with like
+            if (i > 0 &&
+                glm_vec4_dot(samples[i], samples[i - 1]) < 0.0f)
+            {
+                glm_vec4_negate(samples[i]);
+            }
+        }
+    }
+
+    skCompressedTrack* track = &bone->positionTrack;
+    float              tolerance = compression->positionTolerance;
+    bool               rotation = channel == skBoneChannel_Rotation;
+
+    if (rotation)
+    {
+        track = &bone->rotationTrack;
+        tolerance = compression->rotationTolerance;
+    }
+    else if (channel == skBoneChannel_Scale)
+    {
+        track = &bone->scaleTrack;
+        tolerance = compression->scaleTolerance;
+    }
+
+    int stride =
+        skBone_ReduceSamples(samples, intervals, rotation, tolerance);
+    skBone_QuantizeTrack(track, samples, intervals, stride, rotation);
+
+    free(samples);
+}
+
+void skBone_Compress(skBone* bone, float duration,
+                     float ticksPerSecond,
+                     const skBoneCompression* compression)
+{
+    if (bone->compressed)
+        return;
+
+    if (ticksPerSecond <= 0.0f)
+        ticksPerSecond = 25.0f; // What assimp assumes when unset
+
+    skBone_CompressChannel(bone, skBoneChannel_Position,
+                           bone->positionTimes, bone->numPositions,
+                           duration, ticksPerSecond, compression);
+    skBone_CompressChannel(bone, skBoneChannel_Rotation,
+                           bone->rotationTimes, bone->numRotations,
+                           duration, ticksPerSecond, compression);
+    skBone_CompressChannel(bone, skBoneChannel_Scale,
+                           bone->scaleTimes, bone->numScales,
+                           duration, ticksPerSecond, compression);
+
+    free(bone->positionTimes);
+    free(bone->positionValues);
+    free(bone->rotationTimes);
+    free(bone->rotationValues);
+    free(bone->scaleTimes);
+    free(bone->scaleValues);
+    bone->positionTimes = NULL;
+    bone->positionValues = NULL;
+    bone->rotationTimes = NULL;
+    bone->rotationValues = NULL;
+    bone->scaleTimes = NULL;
+    bone->scaleValues = NULL;
+
+    bone->duration = duration;
+    bone->compressed = true;
+}
+
+// The two keys around animationTime and how far between them it is,
+// keys are evenly spaced so there's nothing to search
+static float skCompressedTrack_Locate(const skCompressedTrack* track,
+                                      float duration,
+                                      float animationTime, int* key)
+{
+    if (track->count == 1 || duration <= 0.0f)
+    {
+        *key = 0;
+        return 0.0f;
+    }
+
+    float position = glm_clamp(animationTime / duration, 0.0f, 1.0f) *
+                     (float)(track->count - 1);
+    int   index = (int)position;
+    if (index > track->count - 2)
+        index = track->count - 2;
+
+    *key = index;
+    return position - (float)index;
+}
+
+static void skBone_SampleCompressed(skBone* bone, float animationTime,
+                                    vec3 position, vec4 rotation,
+                                    vec3 scale)
+{
+    vec3 next3;
+    vec4 next4;
+    int  key;
+
+    float t = skCompressedTrack_Locate(&bone->positionTrack,
+                                       bone->duration, animationTime,
+                                       &key);
+    skCompressedTrack_DecodeVec3(&bone->positionTrack,
+                                 bone->positionTrack.keys + key * 3,
+                                 position);
+    if (bone->positionTrack.count > 1)
+    {
+        skCompressedTrack_DecodeVec3(
+            &bone->positionTrack,
+            bone->positionTrack.keys + key * 3 + 3, next3);
+        glm_vec3_mix(position, next3, t, position);
+    }
+
+    t = skCompressedTrack_Locate(&bone->rotationTrack, bone->duration,
+                                 animationTime, &key);
+    skCompressedTrack_DecodeQuat(bone->rotationTrack.keys + key * 3,
+                                 rotation);
+    if (bone->rotationTrack.count > 1)
+    {
+        skCompressedTrack_DecodeQuat(
+            bone->rotationTrack.keys + key * 3 + 3, next4);
+        glm_quat_slerp(rotation, next4, t, rotation);
+    }
+
+    t = skCompressedTrack_Locate(&bone->scaleTrack, bone->duration,
+                                 animationTime, &key);
+    skCompressedTrack_DecodeVec3(&bone->scaleTrack,
+                                 bone->scaleTrack.keys + key * 3,
+                                 scale);
+    if (bone->scaleTrack.count > 1)
+    {
+        skCompressedTrack_DecodeVec3(
+            &bone->scaleTrack, bone->scaleTrack.keys + key * 3 + 3,
+            next3);
+        glm_vec3_mix(scale, next3, t, scale);
+    }
+}
+
+void skBone_Sample(skBone* bone, float animationTime,
+                   skKeyCursor* cursor, vec3 position, vec4 rotation,
+                   vec3 scale)
+{
+    if (bone->compressed)
+    {
+        skBone_SampleCompressed(bone, animationTime, position,
+                                rotation, scale);
+        return;
+    }
+
+    skBone_SamplePosition(bone, animationTime, cursor, position);
+    skBone_SampleRotation(bone, animationTime, cursor, rotation);
+    skBone_SampleScale(bone, animationTime, cursor, scale);
+}
+
+void skBone_Update(skBone* bone, float animationTime,
+                   skKeyCursor* cursor, mat4 dest)
 {
-    mat4 trans = GLM_MAT4_IDENTITY_INIT,
-         rotation = GLM_MAT4_IDENTITY_INIT,
-         scale = GLM_MAT4_IDENTITY_INIT;
-    skBone_InterpolatePosition(bone, animationTime, trans);
-    skBone_InterpolateRotation(bone, animationTime, rotation);
-    skBone_InterpolateScale(bone, animationTime, scale);
-    glm_mat4_mul(trans, rotation, bone->localTransform);
-    glm_mat4_mul(bone->localTransform, scale, bone->localTransform);
+    vec3 position, scale;
+    vec4 rotation;
+    skBone_Sample(bone, animationTime, cursor, position, rotation,
+                  scale);
+
+    // Translation * rotation * scale, without the full products
+    glm_quat_mat4(rotation, dest);
+    glm_scale(dest, scale);
+    glm_vec3_copy(position, dest[3]);
 }
@@ -1,9 +1,14 @@
 #include <sulkan/ecs_api.h>
 #include <sulkan/ecs.hpp>
+#include <sulkan/job_system.hpp>
 #include <vector>
 #include <unordered_map>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <mutex>
+#include <algorithm>
+#include <memory>
 
 // Store the Scene struct as an opaque pointer
 struct skScene_t
@@ -13,9 +18,14 @@ struct skScene_t
         componentTypeMap; // Maps our skComponentTypeID to internal
                           // IDs
     int nextInternalId;
-
-    skScene_t()
-       : nextInternalId(1) {} // Start at 1 to avoid conflicts with 0
+    // Unique for every scene ever created, a query made for a scene
+    // that was destroyed doesn't match one allocated at its address
+    uint32_t id;
+
+    skScene_t(StorageMode mode = StorageMode::Sparse)
+       : cppScene(mode),
+         nextInternalId(1), // Start at 1 to avoid conflicts with 0
+         id(0) {}
 };
 
 // Custom structure for the entity iterator
@@ -28,9 +38,123 @@ struct skEntityIterator_t
     bool                    iterateAll;
 };
 
+// A query handle, the resolved internal ids are kept so lookups
+// through the query don't have to go through componentTypeMap
+struct skECSQuery_t
+{
+    skSceneHandle    scene;
+    uint32_t         sceneId;
+    SceneQuery*      query; // Owned by the scene
+    std::vector<int> internalIds;
+
+    // Kept between skECS_ParallelForEach calls so it doesn't allocate
+    struct Range
+    {
+        skECSQuery_t*     query;
+        const skEntityID* entities;
+        size_t            count;
+    };
+    std::vector<Range>   ranges;
+    std::vector<Job>     jobs;
+    skECSForEachFunction forEachFunction;
+    void*                forEachData;
+
+    // Change detection, one filter per term, the tick the current
+    // pass compares against and the tick only the current pass writes
+    // with
+    std::vector<skECSQueryFilter> filters;
+    bool                          filtered;
+    uint32_t                      sinceTick;
+    uint32_t                      lastPassTick;
+    // Entities that passed the filters, for skECS_ParallelForEach
+    std::vector<skEntityID> passed;
+};
+
+// Placeholder ids from skECS_CommandSpawn use this index, the version
+// holds the recording thread in the top 8 bits and the spawn number
+// in the rest
+static const EntityIndex DEFERRED_INDEX = EntityIndex(-2);
+
+enum class CommandType
+{
+    Assign,
+    Remove
+};
+
+struct Command
+{
+    CommandType       type;
+    skEntityID        entity;
+    skComponentTypeID typeId;
+    size_t            size;
+    void*             pData;
+};
+
+// The commands recorded by one thread
+struct alignas(64) CommandStream
+{
+    std::vector<Command>    commands;
+    std::vector<skEntityID> destroys;
+    ScratchArena            data;
+    unsigned int            spawnCount {0};
+    // Real ids of this thread's spawns after playback
+    std::vector<skEntityID> spawned;
+};
+
+struct skECSCommandBuffer_t
+{
+    skSceneHandle                    scene;
+    std::unique_ptr<CommandStream[]> streams;
+    int                              streamCount;
+    // Reused between playbacks
+    std::vector<ComponentMask> spawnMasks;
+    std::vector<skEntityID>    destroys;
+};
+
 extern "C"
 {
 
+// Every live scene, the component types that parallel systems declare
+// get their internal ids in all of them up front so no system ever
+// inserts into a componentTypeMap while others are reading it
+static std::vector<skSceneHandle> g_scenes;
+static uint32_t                   g_nextSceneId = 1;
+
+// Keeps queries made and destroyed on different threads apart, see
+// skECS_CreateQuery for when it's safe to make them
+static std::mutex g_queryMutex;
+
+static int
+GetOrCreateInternalComponentId(skSceneHandle     scene,
+                               skComponentTypeID externalTypeId,
+                               size_t            componentSize);
+
+static void RegisterSystemTypes(skSceneHandle     scene,
+                                const SystemDesc& desc)
+{
+    for (size_t id : desc.reads)
+    {
+        GetOrCreateInternalComponentId(scene, id, 0);
+    }
+    for (size_t id : desc.writes)
+    {
+        GetOrCreateInternalComponentId(scene, id, 0);
+    }
+}
+
+static void TrackScene(skSceneHandle scene)
+{
+    for (const SystemDesc& desc : systemScheduler.systems)
+    {
+        RegisterSystemTypes(scene, desc);
+    }
+    scene->id = g_nextSceneId++;
+    g_scenes.push_back(scene);
+
+    // Systems remake their queries for a new scene
+    systemScheduler.RunSerially();
+}
+
 // FNV-1a hash function for strings
 unsigned int skECS_HashString(const char* str)
 {
@@ -46,6 +170,16 @@ unsigned int skECS_HashString(const char* str)
 skSceneHandle skECS_CreateScene(void)
 {
     skSceneHandle handle = new skScene_t();
+    TrackScene(handle);
+    return handle;
+}
+
+skSceneHandle skECS_CreateSceneWithStorage(skECSStorageMode mode)
+{
+    skSceneHandle handle = new skScene_t(
+        mode == skECSStorageMode_Archetype ? StorageMode::Archetype
+                                           : StorageMode::Sparse);
+    TrackScene(handle);
     return handle;
 }
 
@@ -53,6 +187,9 @@ void skECS_DestroyScene(skSceneHandle scene)
 {
     if (scene)
     {
+        g_scenes.erase(
+            std::remove(g_scenes.begin(), g_scenes.end(), scene),
+            g_scenes.end());
         scene->cppScene.Clear();
         delete scene;
     }
@@ -62,9 +199,10 @@ void skECS_ClearScene(skSceneHandle scene)
 {
     if (scene)
     {
+        // The component type map is kept so queries created before
+        // the clear keep pointing at the right internal ids, the
+        // storage gets registered again on the next assign
         scene->cppScene.Clear();
-        scene->componentTypeMap.clear();
-        scene->nextInternalId = 1;
     }
 }
 
@@ -77,11 +215,29 @@ int skECS_EntityCount(skSceneHandle scene)
     return 0;
 }
 
+void skECS_SetEntityBudget(skSceneHandle scene, size_t budget)
+{
+    if (scene)
+    {
+        scene->cppScene.SetEntityBudget(budget);
+    }
+}
+
 skEntityID skECS_AddEntity(skSceneHandle scene)
 {
     if (!scene)
         return SK_ECS_INVALID_ENTITY;
-    return scene->cppScene.AddEntity();
+
+    EntityID entity = scene->cppScene.AddEntity();
+    if (entity == INVALID_ENTITY)
+    {
+        printf("SK ERROR: in skECS_AddEntity, the scene's entity "
+               "budget of %zu is used up.\n",
+               scene->cppScene.entityBudget);
+        return SK_ECS_INVALID_ENTITY;
+    }
+
+    return entity;
 }
 
 void skECS_DestroyEntity(skSceneHandle scene, skEntityID entity)
@@ -116,29 +272,27 @@ GetOrCreateInternalComponentId(skSceneHandle     scene,
                                skComponentTypeID externalTypeId,
                                size_t            componentSize)
 {
+    int internalId;
+
     // Check if we already have this component type registered
     auto it = scene->componentTypeMap.find(externalTypeId);
     if (it != scene->componentTypeMap.end())
     {
-        return it->second;
+        internalId = it->second;
     }
-
-    // Otherwise, create a new internal ID
-    int internalId = scene->nextInternalId++;
-    scene->componentTypeMap[externalTypeId] = internalId;
-
-    // Ensure the component pools are large enough
-    if (scene->cppScene.componentPools.size() <= internalId)
+    else
     {
-        scene->cppScene.componentPools.resize(internalId + 1,
-                                              nullptr);
+        // Otherwise, create a new internal ID
+        internalId = scene->nextInternalId++;
+        scene->componentTypeMap[externalTypeId] = internalId;
     }
 
-    // Create the component pool if it doesn't exist
-    if (!scene->cppScene.componentPools[internalId])
+    // Let the scene create the storage for the component, queries
+    // create ids without knowing the size so this can happen later
+    if (componentSize != 0 &&
+        !scene->cppScene.IsComponentRegistered(internalId))
     {
-        scene->cppScene.componentPools[internalId] =
-            new ComponentPool(componentSize);
+        scene->cppScene.RegisterComponent(internalId, componentSize);
     }
 
     return internalId;
@@ -158,25 +312,11 @@ void* skECS_AssignComponent(skSceneHandle scene, skEntityID entity,
     Scene*      pScene = &scene->cppScene;
     EntityIndex entityIndex = GetEntityIndex(entity);
 
-    // Check if the entity already has this component
-    if (entityIndex < pScene->entities.size() &&
-        pScene->entities[entityIndex].mask.test(internalId))
-    {
-        // Component already exists, just return the pointer
-        return pScene->componentPools[internalId]->get(entityIndex);
-    }
-
-    // Component doesn't exist, create it
-    void* componentMemory =
-        pScene->componentPools[internalId]->get(entityIndex);
-
-    // Initialize the memory to zero
-    std::memset(componentMemory, 0, componentSize);
-
-    // Set the component bit
-    pScene->entities[entityIndex].mask.set(internalId);
+    if (entityIndex >= pScene->entities.size())
+        return NULL;
 
-    return componentMemory;
+    // Returns the existing component, or zeroed memory for a new one
+    return pScene->AssignRaw(entity, internalId);
 }
 
 void* skECS_GetComponent(skSceneHandle scene, skEntityID entity,
@@ -196,16 +336,8 @@ void* skECS_GetComponent(skSceneHandle scene, skEntityID entity,
     Scene*      pScene = &scene->cppScene;
     EntityIndex entityIndex = GetEntityIndex(entity);
 
-    // Check if the entity has this component
-    if (entityIndex >= pScene->entities.size() ||
-        !pScene->entities[entityIndex].mask.test(internalId) ||
-        internalId >= pScene->componentPools.size() ||
-        !pScene->componentPools[internalId])
-    {
-        return NULL;
-    }
-
-    return pScene->componentPools[internalId]->get(entityIndex);
+    // Returns NULL if the entity doesn't have this component
+    return pScene->GetRaw(entityIndex, internalId);
 }
 
 void skECS_RemoveComponent(skSceneHandle scene, skEntityID entity,
@@ -221,19 +353,8 @@ void skECS_RemoveComponent(skSceneHandle scene, skEntityID entity,
         return; // Component type not registered
     }
 
-    int         internalId = it->second;
-    Scene*      pScene = &scene->cppScene;
-    EntityIndex entityIndex = GetEntityIndex(entity);
-
-    // Check if the entity is valid
-    if (entityIndex >= pScene->entities.size() ||
-        pScene->entities[entityIndex].id != entity)
-    {
-        return;
-    }
-
-    // Reset the component bit
-    pScene->entities[entityIndex].mask.reset(internalId);
+    // Checks that the entity is still alive before removing
+    scene->cppScene.RemoveRaw(entity, it->second);
 }
 
 void skECS_AddSystem(skSystemFunction system, 
@@ -242,6 +363,26 @@ void skECS_AddSystem(skSystemFunction system,
     AddSystem(system, isStartSystem);
 }
 
+void skECS_AddSystemWithAccess(skSystemFunction  system,
+                               bool              isStartSystem,
+                               skECSSystemAccess access)
+{
+    SystemDesc desc;
+    desc.function = system;
+    desc.declared = true;
+    desc.mainThread = access.mainThread;
+    desc.reads.assign(access.reads, access.reads + access.readCount);
+    desc.writes.assign(access.writes,
+                       access.writes + access.writeCount);
+
+    for (skSceneHandle scene : g_scenes)
+    {
+        RegisterSystemTypes(scene, desc);
+    }
+
+    AddSystem(desc, isStartSystem);
+}
+
 void skECS_UpdateSystems(skECSState* state)
 {
     UpdateSystems(state);
@@ -364,6 +505,28 @@ skECS_CreateEntityIterator(skSceneHandle            scene,
         mask.set(internalId);
     }
 
+    // With archetype storage only the chunks of matching archetypes
+    // are visited, their entity ids are already packed together
+    if (iterator->pScene->storage == StorageMode::Archetype)
+    {
+        for (Archetype* archetype : iterator->pScene->archetypes)
+        {
+            if (mask != (mask & archetype->mask))
+                continue;
+
+            for (size_t chunk = 0; chunk < archetype->chunks.size();
+                 chunk++)
+            {
+                EntityID* ids = archetype->Entities(chunk);
+                iterator->matchingEntities.insert(
+                    iterator->matchingEntities.end(), ids,
+                    ids + archetype->chunks[chunk].count);
+            }
+        }
+
+        return iterator;
+    }
+
     // Pre-collect matching entities for iteration
     const auto&  entities = iterator->pScene->entities;
     const size_t entSize = entities.size();
@@ -430,4 +593,623 @@ void skECS_DestroyEntityIterator(skEntityIteratorHandle iterator)
     }
 }
 
+skECSQuery skECS_CreateQuery(skSceneHandle            scene,
+                             const skComponentTypeID* componentTypeIds,
+                             int                      componentCount)
+{
+    if (!scene)
+        return NULL;
+
+    // Making a query changes the type map and the scene's query list,
+    // which parallel systems read without locking. The scheduler runs
+    // systems alone after systems are added and scenes created so
+    // SK_ECS_QUERY makes its queries then
+    if (systemScheduler.RunningInParallel())
+    {
+        printf("SK ERROR: Query created while systems run in "
+               "parallel, create it on a system's first run\n");
+    }
+
+    std::lock_guard<std::mutex> lock(g_queryMutex);
+
+    skECSQuery query = new skECSQuery_t();
+    query->scene = scene;
+    query->sceneId = scene->id;
+
+    // Component types that haven't been assigned yet get an internal
+    // id now, so the query matches once they are
+    ComponentMask mask;
+    for (int i = 0; i < componentCount; i++)
+    {
+        int internalId = GetOrCreateInternalComponentId(
+            scene, componentTypeIds[i], 0);
+        query->internalIds.push_back(internalId);
+        mask.set(internalId);
+    }
+
+    query->filters.assign(componentCount, skECSQueryFilter_None);
+
+    query->query = scene->cppScene.AddQuery(mask);
+    return query;
+}
+
+// Whether the query's scene still exists, its pointer is only
+// dereferenced once it's known to be a live scene
+static bool IsQuerySceneAlive(skECSQuery query)
+{
+    for (skSceneHandle scene : g_scenes)
+    {
+        if (scene == query->scene)
+            return scene->id == query->sceneId;
+    }
+    return false;
+}
+
+void skECS_DestroyQuery(skECSQuery query)
+{
+    if (query)
+    {
+        std::lock_guard<std::mutex> lock(g_queryMutex);
+
+        // A destroyed scene already freed the query with itself
+        if (IsQuerySceneAlive(query))
+            query->scene->cppScene.RemoveQuery(query->query);
+        delete query;
+    }
+}
+
+skSceneHandle skECS_QueryScene(skECSQuery query)
+{
+    return query && IsQuerySceneAlive(query) ? query->scene : NULL;
+}
+
+size_t skECS_QueryCount(skECSQuery query)
+{
+    return query ? query->query->Count() : 0;
+}
+
+// Starts a pass over a query. The pass gets a tick of its own, the
+// scene's tick moves past it so every other write is newer. Writes
+// through the query are stamped with it, so the next pass only sees
+// what changed after this one and not its own writes
+static void BeginQueryPass(skECSQuery query)
+{
+    Scene* scene = &query->scene->cppScene;
+    query->sinceTick = query->lastPassTick;
+    query->lastPassTick = scene->AdvanceTick() + 1;
+    scene->AdvanceTick();
+}
+
+static bool CheckTerm(skECSQuery query, skEntityID entity,
+                      int termIndex, skECSQueryFilter filter)
+{
+    ComponentTicks* ticks = query->scene->cppScene.GetTicks(
+        GetEntityIndex(entity), query->internalIds[termIndex]);
+    if (!ticks)
+        return false;
+
+    uint32_t tick = filter == skECSQueryFilter_Added ? ticks->added
+                                                     : ticks->changed;
+    return IsNewerTick(tick, query->sinceTick);
+}
+
+// Whether an entity passes the query's filters for the current pass
+static bool PassesFilters(skECSQuery query, skEntityID entity)
+{
+    for (int i = 0; i < (int)query->filters.size(); i++)
+    {
+        if (query->filters[i] != skECSQueryFilter_None &&
+            CheckTerm(query, entity, i, query->filters[i]))
+            return true;
+    }
+    return false;
+}
+
+skECSQueryIterator skECS_QueryBegin(skECSQuery query)
+{
+    skECSQueryIterator iterator = {query, 0, 0};
+    if (query)
+    {
+        BeginQueryPass(query);
+    }
+    return iterator;
+}
+
+// The next match of the query, ignoring the filters
+static skEntityID NextMatch(skECSQueryIterator* iterator)
+{
+    SceneQuery* query = iterator->query->query;
+
+    if (iterator->query->scene->cppScene.storage ==
+        StorageMode::Archetype)
+    {
+        // group is the archetype and index the row inside of it
+        while (iterator->group < query->archetypes.size())
+        {
+            Archetype* archetype = query->archetypes[iterator->group];
+            if (iterator->index < archetype->count)
+            {
+                return archetype->EntityAt(iterator->index++);
+            }
+
+            iterator->group++;
+            iterator->index = 0;
+        }
+
+        return SK_ECS_INVALID_ENTITY;
+    }
+
+    if (iterator->index < query->matches.size())
+    {
+        return query->matches[iterator->index++];
+    }
+
+    return SK_ECS_INVALID_ENTITY;
+}
+
+skEntityID skECS_QueryNext(skECSQueryIterator* iterator)
+{
+    if (!iterator || !iterator->query)
+        return SK_ECS_INVALID_ENTITY;
+
+    skEntityID entity = NextMatch(iterator);
+    if (iterator->query->filtered)
+    {
+        while (entity != SK_ECS_INVALID_ENTITY &&
+               !PassesFilters(iterator->query, entity))
+        {
+            entity = NextMatch(iterator);
+        }
+    }
+
+    return entity;
+}
+
+void* skECS_QueryGetComponent(skECSQuery query, skEntityID entity,
+                              int termIndex)
+{
+    if (!query || termIndex < 0 ||
+        termIndex >= (int)query->internalIds.size())
+        return NULL;
+
+    return query->scene->cppScene.GetRaw(
+        GetEntityIndex(entity), query->internalIds[termIndex]);
+}
+
+void* skECS_QueryGetComponentMut(skECSQuery query, skEntityID entity,
+                                 int termIndex)
+{
+    void* pComponent =
+        skECS_QueryGetComponent(query, entity, termIndex);
+    if (pComponent)
+    {
+        query->scene->cppScene.MarkChanged(
+            GetEntityIndex(entity), query->internalIds[termIndex],
+            query->lastPassTick);
+    }
+    return pComponent;
+}
+
+void skECS_QuerySetFilter(skECSQuery query, int termIndex,
+                          skECSQueryFilter filter)
+{
+    if (!query || termIndex < 0 ||
+        termIndex >= (int)query->filters.size())
+        return;
+
+    query->filters[termIndex] = filter;
+    query->filtered = false;
+    for (skECSQueryFilter termFilter : query->filters)
+    {
+        if (termFilter != skECSQueryFilter_None)
+        {
+            query->filtered = true;
+        }
+    }
+}
+
+bool skECS_QueryChanged(skECSQuery query, skEntityID entity,
+                        int termIndex)
+{
+    if (!query || termIndex < 0 ||
+        termIndex >= (int)query->internalIds.size())
+        return false;
+
+    return CheckTerm(query, entity, termIndex,
+                     skECSQueryFilter_Changed);
+}
+
+bool skECS_QueryAdded(skECSQuery query, skEntityID entity,
+                      int termIndex)
+{
+    if (!query || termIndex < 0 ||
+        termIndex >= (int)query->internalIds.size())
+        return false;
+
+    return CheckTerm(query, entity, termIndex, skECSQueryFilter_Added);
+}
+
+void skECS_MarkChanged(skSceneHandle scene, skEntityID entity,
+                       skComponentTypeID componentTypeId)
+{
+    if (!scene || !IsEntityValid(entity))
+        return;
+
+    auto it = scene->componentTypeMap.find(componentTypeId);
+    if (it != scene->componentTypeMap.end())
+    {
+        scene->cppScene.MarkChanged(GetEntityIndex(entity),
+                                    it->second);
+    }
+}
+
+static void RunForEachRange(void* data)
+{
+    skECSQuery_t::Range* range = (skECSQuery_t::Range*)data;
+    skECSQuery_t*        query = range->query;
+
+    ScratchArena::Marker marker = scratchArena.Mark();
+    query->forEachFunction(query, range->entities, range->count,
+                           currentWorker, query->forEachData);
+    scratchArena.Restore(marker);
+}
+
+// Splits count entities starting at entities into ranges
+static void AddForEachRanges(skECSQuery        query,
+                             const skEntityID* entities, size_t count,
+                             size_t grainSize)
+{
+    for (size_t start = 0; start < count; start += grainSize)
+    {
+        size_t rangeCount = std::min(grainSize, count - start);
+        query->ranges.push_back(
+            {query, entities + start, rangeCount});
+    }
+}
+
+void skECS_ParallelForEach(skECSQuery query, skECSForEachFunction fn,
+                           void* userdata, size_t grainSize)
+{
+    if (!query || !fn)
+        return;
+
+    BeginQueryPass(query);
+
+    size_t count = query->query->Count();
+    if (count == 0)
+        return;
+
+    // Aim for a few ranges per thread so stealing can even them out
+    if (grainSize == 0)
+    {
+        size_t ranges = (size_t)jobSystem.ThreadCount() * 4;
+        grainSize =
+            std::max<size_t>(64, (count + ranges - 1) / ranges);
+    }
+
+    query->forEachFunction = fn;
+    query->forEachData = userdata;
+    query->ranges.clear();
+
+    // Both storage modes keep the entity ids of matches packed, so
+    // the ranges point straight into them. Filtered queries pack the
+    // entities that pass first, that's a quick look at their ticks
+    SceneQuery* sceneQuery = query->query;
+    if (query->filtered)
+    {
+        query->passed.clear();
+        skECSQueryIterator iterator = {query, 0, 0};
+        skEntityID         entity;
+        while ((entity = skECS_QueryNext(&iterator)) !=
+               SK_ECS_INVALID_ENTITY)
+        {
+            query->passed.push_back(entity);
+        }
+
+        AddForEachRanges(query, query->passed.data(),
+                         query->passed.size(), grainSize);
+    }
+    else if (query->scene->cppScene.storage == StorageMode::Archetype)
+    {
+        for (Archetype* archetype : sceneQuery->archetypes)
+        {
+            for (size_t chunk = 0; chunk < archetype->chunks.size();
+                 chunk++)
+            {
+                AddForEachRanges(query, archetype->Entities(chunk),
+                                 archetype->chunks[chunk].count,
+                                 grainSize);
+            }
+        }
+    }
+    else
+    {
+        AddForEachRanges(query, sceneQuery->matches.data(),
+                         sceneQuery->matches.size(), grainSize);
+    }
+
+    if (query->ranges.empty())
+        return;
+
+    // A single range isn't worth handing to another thread
+    if (query->ranges.size() == 1)
+    {
+        RunForEachRange(&query->ranges[0]);
+        return;
+    }
+
+    std::atomic<int> counter((int)query->ranges.size());
+    query->jobs.clear();
+    for (skECSQuery_t::Range& range : query->ranges)
+    {
+        query->jobs.push_back({RunForEachRange, &range, &counter});
+    }
+
+    jobSystem.SubmitBatch(query->jobs.data(), query->jobs.size());
+    jobSystem.Wait(counter);
+}
+
+skECSCommandBuffer skECS_CreateCommandBuffer(skSceneHandle scene)
+{
+    if (!scene)
+        return NULL;
+
+    skECSCommandBuffer buffer = new skECSCommandBuffer_t();
+    buffer->scene = scene;
+    buffer->streamCount = jobSystem.ThreadCount();
+    buffer->streams =
+        std::make_unique<CommandStream[]>(buffer->streamCount);
+    return buffer;
+}
+
+void skECS_DestroyCommandBuffer(skECSCommandBuffer buffer)
+{
+    delete buffer;
+}
+
+// The calling thread's stream
+static CommandStream* GetCommandStream(skECSCommandBuffer buffer)
+{
+    if (currentWorker >= buffer->streamCount)
+    {
+        printf("SK ERROR: command buffer used from job system thread "
+               "%d, it was created for %d threads.\n",
+               currentWorker, buffer->streamCount);
+        return nullptr;
+    }
+
+    return &buffer->streams[currentWorker];
+}
+
+static bool IsDeferredEntity(skEntityID entity)
+{
+    return GetEntityIndex(entity) == DEFERRED_INDEX;
+}
+
+skEntityID skECS_CommandSpawn(skECSCommandBuffer buffer)
+{
+    CommandStream* stream =
+        buffer ? GetCommandStream(buffer) : nullptr;
+    if (!stream)
+        return SK_ECS_INVALID_ENTITY;
+
+    EntityVersion version =
+        ((EntityVersion)currentWorker << 24) | stream->spawnCount++;
+    return CreateEntityId(DEFERRED_INDEX, version);
+}
+
+void skECS_CommandDestroy(skECSCommandBuffer buffer,
+                          skEntityID         entity)
+{
+    CommandStream* stream =
+        buffer ? GetCommandStream(buffer) : nullptr;
+    if (stream && IsEntityValid(entity))
+    {
+        stream->destroys.push_back(entity);
+    }
+}
+
+void* skECS_CommandAssign(skECSCommandBuffer buffer, skEntityID entity,
+                          skComponentTypeID componentTypeId,
+                          size_t            componentSize)
+{
+    CommandStream* stream =
+        buffer ? GetCommandStream(buffer) : nullptr;
+    if (!stream || !IsEntityValid(entity))
+        return NULL;
+
+    void* pData = stream->data.Alloc(componentSize);
+    std::memset(pData, 0, componentSize);
+
+    stream->commands.push_back({CommandType::Assign, entity,
+                                componentTypeId, componentSize,
+                                pData});
+    return pData;
+}
+
+void skECS_CommandRemove(skECSCommandBuffer buffer, skEntityID entity,
+                         skComponentTypeID componentTypeId)
+{
+    CommandStream* stream =
+        buffer ? GetCommandStream(buffer) : nullptr;
+    if (stream && IsEntityValid(entity))
+    {
+        stream->commands.push_back({CommandType::Remove, entity,
+                                    componentTypeId, 0, nullptr});
+    }
+}
+
+skEntityID skECS_CommandResolve(skECSCommandBuffer buffer,
+                                skEntityID         spawned)
+{
+    if (!buffer || !IsDeferredEntity(spawned))
+        return spawned;
+
+    EntityVersion version = GetEntityVersion(spawned);
+    int           thread = (int)(version >> 24);
+    unsigned int  spawn = version & 0xFFFFFF;
+
+    if (thread >= buffer->streamCount ||
+        spawn >= buffer->streams[thread].spawned.size())
+        return SK_ECS_INVALID_ENTITY;
+
+    return buffer->streams[thread].spawned[spawn];
+}
+
+// Index of a placeholder in spawnMasks, -1 if it wasn't spawned since
+// the last playback
+static long long SpawnSlot(skECSCommandBuffer         buffer,
+                           skEntityID                 spawned,
+                           const std::vector<size_t>& firstSpawn)
+{
+    EntityVersion version = GetEntityVersion(spawned);
+    int           thread = (int)(version >> 24);
+    unsigned int  spawn = version & 0xFFFFFF;
+
+    if (thread >= buffer->streamCount ||
+        spawn >= buffer->streams[thread].spawnCount)
+        return -1;
+
+    return (long long)(firstSpawn[thread] + spawn);
+}
+
+void skECS_PlaybackCommandBuffer(skECSCommandBuffer buffer)
+{
+    if (!buffer)
+        return;
+
+    skSceneHandle scene = buffer->scene;
+    Scene*        pScene = &scene->cppScene;
+
+    // Where each stream's spawns start in spawnMasks
+    std::vector<size_t> firstSpawn(buffer->streamCount);
+    size_t              spawnTotal = 0;
+    for (int i = 0; i < buffer->streamCount; i++)
+    {
+        firstSpawn[i] = spawnTotal;
+        spawnTotal += buffer->streams[i].spawnCount;
+    }
+
+    // Work out the final components of every spawned entity, so it
+    // can be created straight into its archetype or pools
+    buffer->spawnMasks.assign(spawnTotal, ComponentMask());
+    for (int i = 0; i < buffer->streamCount; i++)
+    {
+        for (Command& command : buffer->streams[i].commands)
+        {
+            if (!IsDeferredEntity(command.entity))
+                continue;
+
+            long long slot =
+                SpawnSlot(buffer, command.entity, firstSpawn);
+            if (slot < 0)
+                continue;
+
+            ComponentMask& mask = buffer->spawnMasks[slot];
+            if (command.type == CommandType::Assign)
+            {
+                mask.set(GetOrCreateInternalComponentId(
+                    scene, command.typeId, command.size));
+            }
+            else
+            {
+                auto it =
+                    scene->componentTypeMap.find(command.typeId);
+                if (it != scene->componentTypeMap.end())
+                {
+                    mask.reset(it->second);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < buffer->streamCount; i++)
+    {
+        CommandStream& stream = buffer->streams[i];
+        stream.spawned.resize(stream.spawnCount);
+
+        for (unsigned int spawn = 0; spawn < stream.spawnCount;
+             spawn++)
+        {
+            EntityID entity = pScene->AddEntityWithMask(
+                buffer->spawnMasks[firstSpawn[i] + spawn]);
+            if (entity == INVALID_ENTITY)
+            {
+                printf("SK ERROR: in skECS_PlaybackCommandBuffer, "
+                       "the scene's entity budget of %zu is used "
+                       "up.\n",
+                       pScene->entityBudget);
+            }
+            stream.spawned[spawn] = entity;
+        }
+    }
+
+    // Component changes, spawned entities already have the right
+    // components so they only get their data copied in
+    for (int i = 0; i < buffer->streamCount; i++)
+    {
+        for (Command& command : buffer->streams[i].commands)
+        {
+            bool       deferred = IsDeferredEntity(command.entity);
+            skEntityID entity =
+                skECS_CommandResolve(buffer, command.entity);
+            if (!IsEntityValid(entity))
+                continue;
+
+            EntityIndex index = GetEntityIndex(entity);
+            if (index >= pScene->entities.size() ||
+                pScene->entities[index].id != entity)
+                continue;
+
+            if (command.type == CommandType::Assign)
+            {
+                int internalId = GetOrCreateInternalComponentId(
+                    scene, command.typeId, command.size);
+
+                // Assigned and then removed again before playback
+                if (deferred &&
+                    !pScene->entities[index].mask.test(internalId))
+                    continue;
+
+                std::memcpy(pScene->AssignRaw(entity, internalId),
+                            command.pData, command.size);
+            }
+            else if (!deferred)
+            {
+                auto it =
+                    scene->componentTypeMap.find(command.typeId);
+                if (it != scene->componentTypeMap.end())
+                {
+                    pScene->RemoveRaw(entity, it->second);
+                }
+            }
+        }
+    }
+
+    // All the destroys go in one batch
+    buffer->destroys.clear();
+    for (int i = 0; i < buffer->streamCount; i++)
+    {
+        for (skEntityID entity : buffer->streams[i].destroys)
+        {
+            entity = skECS_CommandResolve(buffer, entity);
+            if (IsEntityValid(entity))
+            {
+                buffer->destroys.push_back(entity);
+            }
+        }
+    }
+    pScene->DestroyEntities(buffer->destroys.data(),
+                            buffer->destroys.size());
+
+    for (int i = 0; i < buffer->streamCount; i++)
+    {
+        CommandStream& stream = buffer->streams[i];
+        stream.commands.clear();
+        stream.destroys.clear();
+        stream.data.Restore({0, 0});
+        stream.spawnCount = 0;
+    }
+}
+
 } // extern "C"
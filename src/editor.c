@@ -55,6 +55,8 @@ void skEditor_LoadScene(skECSState* state, skSceneHandle scene,
     skJson_Destroy(j);
 
     skECS_StartStartSystems(state);
+    skModelAsset_Collect();
+    skImageAsset_Collect();
 }
 
 void skEditor_DrawHierarchy(skEditor* editor)
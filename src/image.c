@@ -0,0 +1,102 @@
+#include <sulkan/image.h>
+#include <sulkan/map.h>
+#include <stb/stb_image.h>
+#include <stdbool.h>
+
+// skStringID, skImageAsset*, the decoded images by path
+static skMap* skImageAsset_registry;
+
+static void skImageAsset_Decode(void* userdata)
+{
+    skImageAsset* image = (skImageAsset*)userdata;
+
+    int channels;
+    image->pixels =
+        stbi_load(skStringID_String(image->path), &image->width,
+                  &image->height, &channels, STBI_rgb_alpha);
+}
+
+static skImageAsset* skImageAsset_Get(const char* path, bool async)
+{
+    if (!skImageAsset_registry)
+    {
+        skImageAsset_registry = skMap_Create(
+            sizeof(skStringID), sizeof(skImageAsset*), 16,
+            skMap_IntHash, skMap_IntCompare);
+    }
+
+    skStringID id = skStringID_Intern(path);
+
+    skImageAsset** cached =
+        (skImageAsset**)skMap_Get(skImageAsset_registry, &id);
+    skImageAsset* image = cached ? *cached : NULL;
+
+    if (!image)
+    {
+        image = (skImageAsset*)calloc(1, sizeof(skImageAsset));
+        image->path = id;
+        skMap_Insert(skImageAsset_registry, &id, &image);
+
+        if (async)
+        {
+            image->loading = skJobGroup_Create();
+            skJobGroup_Run(image->loading, skImageAsset_Decode,
+                           image);
+        }
+        else
+        {
+            skImageAsset_Decode(image);
+        }
+    }
+
+    image->refCount++;
+    return image;
+}
+
+skImageAsset* skImageAsset_Acquire(const char* path)
+{
+    skImageAsset* image = skImageAsset_Get(path, false);
+    skImageAsset_Wait(image);
+    return image;
+}
+
+skImageAsset* skImageAsset_AcquireAsync(const char* path)
+{
+    return skImageAsset_Get(path, true);
+}
+
+void skImageAsset_Wait(skImageAsset* image)
+{
+    if (!image->loading)
+        return;
+
+    skJobGroup_Free(image->loading);
+    image->loading = NULL;
+}
+
+void skImageAsset_Release(skImageAsset* image)
+{
+    if (image && image->refCount > 0)
+        image->refCount--;
+}
+
+void skImageAsset_Collect(void)
+{
+    if (!skImageAsset_registry)
+        return;
+
+    skMap* registry = skImageAsset_registry;
+    for (size_t i = 0; i < registry->capacity; i++)
+    {
+        skImageAsset** slot =
+            (skImageAsset**)skMap_SlotValue(registry, i);
+        if (!slot || (*slot)->refCount > 0)
+            continue;
+
+        skImageAsset* image = *slot;
+        skImageAsset_Wait(image);
+        skMap_Remove(registry, &image->path);
+        stbi_image_free(image->pixels);
+        free(image);
+    }
+}
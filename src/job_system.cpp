@@ -0,0 +1,154 @@
+#include <sulkan/job_system.h>
+#include <sulkan/job_system.hpp>
+
+#include <algorithm>
+
+struct ParallelForRange
+{
+    skJobRangeFunction function;
+    void*              userdata;
+    size_t             begin;
+    size_t             end;
+};
+
+static void RunParallelForRange(void* data)
+{
+    ParallelForRange* range = (ParallelForRange*)data;
+
+    ScratchArena::Marker marker = scratchArena.Mark();
+    range->function(range->userdata, range->begin, range->end,
+                    currentWorker);
+    scratchArena.Restore(marker);
+}
+
+struct skJobGroup
+{
+    std::atomic<int> counter {0};
+};
+
+// A job of a group, it frees itself once it has run
+struct GroupJob
+{
+    skJobFunction function;
+    void*         userdata;
+};
+
+static void RunGroupJob(void* data)
+{
+    GroupJob job = *(GroupJob*)data;
+    delete (GroupJob*)data;
+
+    ScratchArena::Marker marker = scratchArena.Mark();
+    job.function(job.userdata);
+    scratchArena.Restore(marker);
+}
+
+extern "C"
+{
+
+void skJobSystem_Init(int workerCount)
+{
+    jobSystem.Start(workerCount);
+}
+
+void skJobSystem_Shutdown(void)
+{
+    jobSystem.Stop();
+}
+
+int skJobSystem_ThreadCount(void)
+{
+    return jobSystem.ThreadCount();
+}
+
+int skJobSystem_CurrentThread(void)
+{
+    return currentWorker;
+}
+
+void* skJobSystem_ScratchAlloc(size_t size)
+{
+    return scratchArena.Alloc(size);
+}
+
+void skJobSystem_ParallelFor(size_t count, size_t grainSize,
+                             skJobRangeFunction fn, void* userdata)
+{
+    if (count == 0 || !fn)
+        return;
+
+    // Aim for a few ranges per thread so stealing can even them out
+    if (grainSize == 0)
+    {
+        size_t ranges = (size_t)jobSystem.ThreadCount() * 4;
+        grainSize =
+            std::max<size_t>(1, (count + ranges - 1) / ranges);
+    }
+
+    size_t rangeCount = (count + grainSize - 1) / grainSize;
+
+    // A single range isn't worth handing to another thread
+    if (rangeCount == 1)
+    {
+        ParallelForRange range = {fn, userdata, 0, count};
+        RunParallelForRange(&range);
+        return;
+    }
+
+    // The ranges and jobs only live until Wait returns, so they come
+    // from the calling thread's scratch
+    ScratchArena::Marker marker = scratchArena.Mark();
+
+    ParallelForRange* ranges = (ParallelForRange*)scratchArena.Alloc(
+        rangeCount * sizeof(ParallelForRange));
+    Job* jobs = (Job*)scratchArena.Alloc(rangeCount * sizeof(Job));
+
+    std::atomic<int> counter((int)rangeCount);
+    for (size_t i = 0; i < rangeCount; i++)
+    {
+        size_t begin = i * grainSize;
+        ranges[i] = {fn, userdata, begin,
+                     std::min(count, begin + grainSize)};
+        new (&jobs[i])
+            Job {RunParallelForRange, &ranges[i], &counter};
+    }
+
+    jobSystem.SubmitBatch(jobs, rangeCount);
+    jobSystem.Wait(counter);
+
+    scratchArena.Restore(marker);
+}
+
+skJobGroup* skJobGroup_Create(void)
+{
+    return new skJobGroup;
+}
+
+void skJobGroup_Free(skJobGroup* group)
+{
+    if (!group)
+        return;
+
+    skJobGroup_Wait(group);
+    delete group;
+}
+
+void skJobGroup_Run(skJobGroup* group, skJobFunction fn,
+                    void* userdata)
+{
+    if (!fn)
+        return;
+
+    // Counted before it's queued so a wait can't miss it
+    group->counter.fetch_add(1);
+
+    GroupJob* job = new GroupJob {fn, userdata};
+    jobSystem.Submit(Job {RunGroupJob, job, &group->counter});
+}
+
+void skJobGroup_Wait(skJobGroup* group)
+{
+    jobSystem.Wait(group->counter);
+}
+
+} // extern "C"
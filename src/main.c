@@ -35,15 +35,40 @@ int main(int argc, char** argv)
     skEditor editor = skEditor_Create(
         &ecsState, "res/scenes/main_scene.json", "documentation.md");
 
+    skECS_AddSystem(skDeltaTimeSystem, false);
+    // Writes the camera and the renderer's view, which aren't
+    // components, so it's left undeclared to run alone
     skECS_AddSystem(skCamera_Sys, false);
     skECS_AddSystem(skRenderAssociation_StartSys, true);
     skECS_AddSystem(skLightAssociation_StartSys, true);
-    skECS_AddSystem(skDeltaTimeSystem, false);
     skECS_AddSystem(skRigidbody3D_StartSys, true);
-    skECS_AddSystem(skRigidbody3D_Sys, false);
+    // Both write render object transforms, skRenderObject stands for
+    // the renderer's objects so the two never run at the same time
+    skECS_AddSystemWithAccess(
+        skRigidbody3D_Sys, false,
+        (skECSSystemAccess) {
+            .reads =
+                SK_ECS_TYPES(SK_ECS_COMPONENT_TYPE(skRigidbody3D)),
+            .writes = SK_ECS_TYPES(
+                SK_ECS_COMPONENT_TYPE(skRenderAssociation),
+                SK_ECS_COMPONENT_TYPE(skRenderObject))});
+    skECS_AddSystemWithAccess(
+        skTransform_Sys, false,
+        (skECSSystemAccess) {
+            .reads = SK_ECS_TYPES(
+                SK_ECS_COMPONENT_TYPE(skParent),
+                SK_ECS_COMPONENT_TYPE(skRenderAssociation),
+                SK_ECS_COMPONENT_TYPE(skRigidbody3D)),
+            .writes = SK_ECS_TYPES(
+                SK_ECS_COMPONENT_TYPE(skTransform),
+                SK_ECS_COMPONENT_TYPE(skRenderObject))});
 
     skECS_StartStartSystems(&ecsState);
 
+    // Every model is on the GPU and in the physics world by now
+    skModelAsset_Collect();
+    skImageAsset_Collect();
+
     while (!skWindow_ShouldClose(&window))
     {
         skECS_UpdateSystems(&ecsState);
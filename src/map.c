@@ -1,5 +1,15 @@
 #include <sulkan/map.h>
 #include <assert.h>
+#include <stddef.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SK_MAP_SSE2
+#endif
+
+// Control bytes, a full slot holds the low 7 bits of its key's hash
+#define SK_MAP_EMPTY   0x80
+#define SK_MAP_DELETED 0xFE
 
 // FNV-1a hash function for generic data
 uint32_t skMap_DefaultHash(const void* key, size_t keySize)
@@ -58,12 +68,12 @@ int skMap_StringCompare(const void* key1, const void* key2,
 uint32_t skMap_IntHash(const void* key, size_t keySize)
 {
     (void)keySize;
-    int val = *(const int*)key;
+    uint32_t val = (uint32_t)*(const int*)key;
     // Simple integer hash
     val = ((val >> 16) ^ val) * 0x45d9f3b;
     val = ((val >> 16) ^ val) * 0x45d9f3b;
     val = (val >> 16) ^ val;
-    return (uint32_t)val;
+    return val;
 }
 
 // Integer comparison function
@@ -76,6 +86,166 @@ int skMap_IntCompare(const void* key1, const void* key2,
     return (a > b) - (a < b);
 }
 
+// Bit i is set if control byte i of the group equals value
+static uint32_t skMap_MatchGroup(const uint8_t* group, uint8_t value)
+{
+#ifdef SK_MAP_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)value)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < SK_MAP_GROUP_SIZE; i++)
+    {
+        if (group[i] == value)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// Bit i is set if slot i of the group is empty or deleted
+static uint32_t skMap_MatchFree(const uint8_t* group)
+{
+#ifdef SK_MAP_SSE2
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_loadu_si128((const __m128i*)group));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < SK_MAP_GROUP_SIZE; i++)
+    {
+        if (group[i] & 0x80)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+static int skMap_LowestBit(uint32_t mask)
+{
+    int index = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+}
+
+static uint8_t* skMap_Slot(skMap* map, size_t index)
+{
+    return map->slots + index * map->slotSize;
+}
+
+// Allocates empty storage for capacity slots
+static int skMap_Allocate(skMap* map, size_t capacity)
+{
+    map->ctrl = (uint8_t*)malloc(capacity);
+    map->slots = (uint8_t*)malloc(capacity * map->slotSize);
+    if (map->ctrl == NULL || map->slots == NULL)
+    {
+        free(map->ctrl);
+        free(map->slots);
+        return -1;
+    }
+
+    memset(map->ctrl, SK_MAP_EMPTY, capacity);
+    map->capacity = capacity;
+    map->growthLeft = capacity - capacity / 8;
+    return 0;
+}
+
+// Finds the slot holding the key, or -1. Groups are probed with
+// growing steps until one has an empty slot, the key can't be past it
+static ptrdiff_t skMap_Find(skMap* map, const void* key,
+                            uint32_t hash)
+{
+    size_t  groupMask = map->capacity / SK_MAP_GROUP_SIZE - 1;
+    size_t  group = (hash >> 7) & groupMask;
+    uint8_t h2 = (uint8_t)(hash & 0x7F);
+
+    for (size_t step = 1;; step++)
+    {
+        size_t   first = group * SK_MAP_GROUP_SIZE;
+        uint32_t match = skMap_MatchGroup(map->ctrl + first, h2);
+
+        while (match)
+        {
+            size_t index = first + skMap_LowestBit(match);
+            if (map->cmp_func(skMap_Slot(map, index), key,
+                              map->keySize) == 0)
+            {
+                return (ptrdiff_t)index;
+            }
+            match &= match - 1;
+        }
+
+        if (skMap_MatchGroup(map->ctrl + first, SK_MAP_EMPTY))
+            return -1;
+
+        if (step > groupMask)
+            return -1;
+
+        group = (group + step) & groupMask;
+    }
+}
+
+// The first empty or deleted slot on the key's probe sequence
+static size_t skMap_FindFree(skMap* map, uint32_t hash)
+{
+    size_t groupMask = map->capacity / SK_MAP_GROUP_SIZE - 1;
+    size_t group = (hash >> 7) & groupMask;
+
+    for (size_t step = 1;; step++)
+    {
+        size_t   first = group * SK_MAP_GROUP_SIZE;
+        uint32_t available = skMap_MatchFree(map->ctrl + first);
+        if (available)
+            return first + skMap_LowestBit(available);
+
+        group = (group + step) & groupMask;
+    }
+}
+
+// Moves every element into new storage, growing it unless most of the
+// used up space is deleted slots
+static int skMap_Rehash(skMap* map)
+{
+    size_t capacity = map->capacity;
+    if (map->size >= capacity / 2)
+        capacity *= 2;
+
+    uint8_t* oldCtrl = map->ctrl;
+    uint8_t* oldSlots = map->slots;
+    size_t   oldCapacity = map->capacity;
+
+    if (skMap_Allocate(map, capacity) != 0)
+    {
+        map->ctrl = oldCtrl;
+        map->slots = oldSlots;
+        return -1;
+    }
+
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldCtrl[i] & 0x80)
+            continue;
+
+        uint8_t* slot = oldSlots + i * map->slotSize;
+        uint32_t hash = map->hash_func(slot, map->keySize);
+        size_t   index = skMap_FindFree(map, hash);
+
+        map->ctrl[index] = (uint8_t)(hash & 0x7F);
+        memcpy(skMap_Slot(map, index), slot, map->slotSize);
+    }
+
+    map->growthLeft -= map->size;
+
+    free(oldCtrl);
+    free(oldSlots);
+    return 0;
+}
+
 // Create a new hash map
 skMap* skMap_Create(size_t keySize, size_t valueSize,
                     size_t initial_bucket_count, skHashFunc hash_func,
@@ -92,63 +262,32 @@ skMap* skMap_Create(size_t keySize, size_t valueSize,
         return NULL;
     }
 
-    map->buckets = (skMapEntry**)calloc(initial_bucket_count,
-                                        sizeof(skMapEntry*));
-    if (map->buckets == NULL)
-    {
-        free(map);
-        fprintf(stderr,
-                "Failed to allocate memory for map buckets.\n");
-        assert(1);
-        return NULL;
-    }
-
+    // Values are aligned to 16 bytes like a malloc'd copy would be
     map->keySize = keySize;
     map->valueSize = valueSize;
-    map->bucket_count = initial_bucket_count;
+    map->valueOffset = (keySize + 15) & ~(size_t)15;
+    map->slotSize = (map->valueOffset + valueSize + 15) & ~(size_t)15;
     map->size = 0;
     map->hash_func = hash_func ? hash_func : skMap_DefaultHash;
     map->cmp_func = cmp_func ? cmp_func : skMap_DefaultCompare;
 
-    return map;
-}
-
-// Create a new entry
-static skMapEntry* skMapEntry_Create(const void* key,
-                                     const void* value,
-                                     size_t keySize, size_t valueSize)
-{
-    skMapEntry* entry = (skMapEntry*)malloc(sizeof(skMapEntry));
-    if (entry == NULL)
-        return NULL;
-
-    entry->key = malloc(keySize);
-    entry->value = malloc(valueSize);
-
-    if (entry->key == NULL || entry->value == NULL)
+    // Keep the map at most 7/8 full
+    size_t capacity = SK_MAP_GROUP_SIZE;
+    while (capacity - capacity / 8 < initial_bucket_count)
     {
-        free(entry->key);
-        free(entry->value);
-        free(entry);
-        return NULL;
+        capacity *= 2;
     }
 
-    memcpy(entry->key, key, keySize);
-    memcpy(entry->value, value, valueSize);
-    entry->next = NULL;
-
-    return entry;
-}
-
-// Free an entry
-static void skMapEntry_Free(skMapEntry* entry)
-{
-    if (entry)
+    if (skMap_Allocate(map, capacity) != 0)
     {
-        free(entry->key);
-        free(entry->value);
-        free(entry);
+        free(map);
+        fprintf(stderr,
+                "Failed to allocate memory for map buckets.\n");
+        assert(1);
+        return NULL;
     }
+
+    return map;
 }
 
 // Insert or update a key-value pair
@@ -157,36 +296,40 @@ int skMap_Insert(skMap* map, const void* key, const void* value)
     if (map == NULL || key == NULL || value == NULL)
         return -1;
 
-    uint32_t hash = map->hash_func(key, map->keySize);
-    size_t   bucket_index = hash % map->bucket_count;
+    uint32_t  hash = map->hash_func(key, map->keySize);
+    ptrdiff_t found = skMap_Find(map, key, hash);
 
-    skMapEntry* current = map->buckets[bucket_index];
+    if (found >= 0)
+    {
+        // Update existing value
+        memcpy(skMap_Slot(map, found) + map->valueOffset, value,
+               map->valueSize);
+        return 0;
+    }
 
-    // Check if key already exists
-    while (current != NULL)
+    size_t index = skMap_FindFree(map, hash);
+
+    // Deleted slots can be reused for free, empty ones use up growth
+    if (map->ctrl[index] == SK_MAP_EMPTY && map->growthLeft == 0)
     {
-        if (map->cmp_func(current->key, key, map->keySize) == 0)
+        if (skMap_Rehash(map) != 0)
         {
-            // Update existing value
-            memcpy(current->value, value, map->valueSize);
-            return 0;
+            fprintf(stderr, "Failed to create new map entry.\n");
+            assert(1);
+            return -1;
         }
-        current = current->next;
-    }
 
-    // Create new entry
-    skMapEntry* new_entry =
-        skMapEntry_Create(key, value, map->keySize, map->valueSize);
-    if (new_entry == NULL)
-    {
-        fprintf(stderr, "Failed to create new map entry.\n");
-        assert(1);
-        return -1;
+        index = skMap_FindFree(map, hash);
     }
 
-    // Insert at head of bucket
-    new_entry->next = map->buckets[bucket_index];
-    map->buckets[bucket_index] = new_entry;
+    if (map->ctrl[index] == SK_MAP_EMPTY)
+        map->growthLeft--;
+
+    map->ctrl[index] = (uint8_t)(hash & 0x7F);
+
+    uint8_t* slot = skMap_Slot(map, index);
+    memcpy(slot, key, map->keySize);
+    memcpy(slot + map->valueOffset, value, map->valueSize);
     map->size++;
 
     return 0;
@@ -198,21 +341,13 @@ void* skMap_Get(skMap* map, const void* key)
     if (map == NULL || key == NULL)
         return NULL;
 
-    uint32_t hash = map->hash_func(key, map->keySize);
-    size_t   bucket_index = hash % map->bucket_count;
-
-    skMapEntry* current = map->buckets[bucket_index];
+    uint32_t  hash = map->hash_func(key, map->keySize);
+    ptrdiff_t found = skMap_Find(map, key, hash);
 
-    while (current != NULL)
-    {
-        if (map->cmp_func(current->key, key, map->keySize) == 0)
-        {
-            return current->value;
-        }
-        current = current->next;
-    }
+    if (found < 0)
+        return NULL; // Key not found
 
-    return NULL; // Key not found
+    return skMap_Slot(map, found) + map->valueOffset;
 }
 
 // Remove a key-value pair
@@ -221,37 +356,28 @@ int skMap_Remove(skMap* map, const void* key)
     if (map == NULL || key == NULL)
         return -1;
 
-    uint32_t hash = map->hash_func(key, map->keySize);
-    size_t   bucket_index = hash % map->bucket_count;
+    uint32_t  hash = map->hash_func(key, map->keySize);
+    ptrdiff_t found = skMap_Find(map, key, hash);
 
-    skMapEntry* current = map->buckets[bucket_index];
-    skMapEntry* prev = NULL;
+    if (found < 0)
+        return -1; // Key not found
 
-    while (current != NULL)
+    // If the group still has an empty slot no probe ever went past
+    // it, so the slot can go back to empty. Otherwise lookups for keys
+    // further along have to keep going, so it's only marked deleted
+    size_t first = found & ~(size_t)(SK_MAP_GROUP_SIZE - 1);
+    if (skMap_MatchGroup(map->ctrl + first, SK_MAP_EMPTY))
     {
-        if (map->cmp_func(current->key, key, map->keySize) == 0)
-        {
-            // Remove this entry
-            if (prev == NULL)
-            {
-                // First entry in bucket
-                map->buckets[bucket_index] = current->next;
-            }
-            else
-            {
-                prev->next = current->next;
-            }
-
-            skMapEntry_Free(current);
-            map->size--;
-            return 0;
-        }
-
-        prev = current;
-        current = current->next;
+        map->ctrl[found] = SK_MAP_EMPTY;
+        map->growthLeft++;
+    }
+    else
+    {
+        map->ctrl[found] = SK_MAP_DELETED;
     }
 
-    return -1; // Key not found
+    map->size--;
+    return 0;
 }
 
 // Check if a key exists
@@ -266,24 +392,23 @@ size_t skMap_Size(skMap* map)
     return map ? map->size : 0;
 }
 
+// A full slot's control byte is hash bits, with the high bit clear
+void* skMap_SlotValue(skMap* map, size_t slot)
+{
+    if (map->ctrl[slot] & 0x80)
+        return NULL;
+
+    return map->slots + slot * map->slotSize + map->valueOffset;
+}
+
 // Clear all elements
 void skMap_Clear(skMap* map)
 {
     if (map == NULL)
         return;
 
-    for (size_t i = 0; i < map->bucket_count; i++)
-    {
-        skMapEntry* current = map->buckets[i];
-        while (current != NULL)
-        {
-            skMapEntry* next = current->next;
-            skMapEntry_Free(current);
-            current = next;
-        }
-        map->buckets[i] = NULL;
-    }
-
+    memset(map->ctrl, SK_MAP_EMPTY, map->capacity);
+    map->growthLeft = map->capacity - map->capacity / 8;
     map->size = 0;
 }
 
@@ -293,7 +418,7 @@ void skMap_Free(skMap* map)
     if (map == NULL)
         return;
 
-    skMap_Clear(map);
-    free(map->buckets);
+    free(map->ctrl);
+    free(map->slots);
     free(map);
 }
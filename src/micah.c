@@ -69,17 +69,21 @@ void skRenderAssociation_DrawComponent(skRenderAssociation* object,
 
             if (skImGui_Button("Update Model"))
             {
-                skModel model = skModel_Create();
-                skModel_Load(&model, object->modelPath);
+                skModelAsset* asset =
+                    skModelAsset_Acquire(object->modelPath);
 
                 skRenderObject* obj = (skRenderObject*)skVector_Get(
                     state->renderer->renderObjects,
                     object->objectIndex);
                 *obj = skRenderObject_CreateFromModel(
-                    state->renderer, &model, 0, object->texturePath,
-                    object->normalTexturePath,
+                    state->renderer, &asset->model, 0,
+                    object->texturePath, object->normalTexturePath,
                     object->roughnessTexturePath);
 
+                skModelAsset_Release(asset);
+                skModelAsset_Collect();
+                skImageAsset_Collect();
+
                 VkDeviceSize bufferSize =
                     sizeof(skUniformBufferObject);
 
@@ -300,12 +304,15 @@ void skRigidbody3D_DrawComponent(skRigidbody3D* object,
             skRenderAssociation* assoc =
                 SK_ECS_GET(state->scene, ent, skRenderAssociation);
 
-            skModel model = skModel_Create();
-            skModel_Load(&model, assoc->modelPath);
+            skModelAsset* asset =
+                skModelAsset_Acquire(assoc->modelPath);
 
             skPhysics3DState_CreateBody(state->physics3dState, state,
-                                        object, assoc, &model);
+                                        object, assoc, &asset->model);
+            skModelAsset_Release(asset);
+            skModelAsset_Collect();
             object->created = true;
+            SK_ECS_MARK_CHANGED(state->scene, ent, skRigidbody3D);
         }
 
         if (skImGui_Button("Update Jolt body for this skRigidbody3D"))
@@ -313,13 +320,16 @@ void skRigidbody3D_DrawComponent(skRigidbody3D* object,
             skRenderAssociation* assoc =
                 SK_ECS_GET(state->scene, ent, skRenderAssociation);
 
-            skModel model = skModel_Create();
-            skModel_Load(&model, assoc->modelPath);
+            skModelAsset* asset =
+                skModelAsset_Acquire(assoc->modelPath);
 
             skPhysics3DState_DestroyBody(state->physics3dState,
                                          state->renderer, object);
             skPhysics3DState_CreateBody(state->physics3dState, state,
-                                        object, assoc, &model);
+                                        object, assoc, &asset->model);
+            skModelAsset_Release(asset);
+            skModelAsset_Collect();
+            SK_ECS_MARK_CHANGED(state->scene, ent, skRigidbody3D);
         }
     }
 }
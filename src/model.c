@@ -1,6 +1,7 @@
 #include <sulkan/model.h>
 #include <stb/stb_image.h>
 #include <assert.h>
+#include <sys/stat.h>
 #include <sulkan/essentials.h>
 
 skMesh skMesh_Create(skVector* meshVertices, skVector* meshIndices,
@@ -54,14 +55,388 @@ skModel skModel_Create()
     skModel model = {0};
 
     model.boneInfoMap =
-        skMap_Create(sizeof(char*), sizeof(skBoneInfo), 0,
-                     skMap_StringHash, skMap_StringCompare);
+        skMap_Create(sizeof(skStringID), sizeof(skBoneInfo), 0,
+                     skMap_IntHash, skMap_IntCompare);
     model.loadedTextures = skVector_Create(sizeof(skTexture), 2);
     model.meshes = skVector_Create(sizeof(skMesh), 2);
+    model.boneBounds = skVector_Create(sizeof(skBoneBounds), 16);
+    glm_aabb_invalidate(model.unskinnedBounds);
 
     return model;
 }
 
+// Cooked meshes are saved next to the source file as path.skmesh,
+// laid out as the header, the mesh, bone, bone bounds and loaded
+// texture tables, each mesh's vertices, indices and textures and
+// last the bone names
+#define SK_MESH_CACHE_MAGIC   0x48534D53 // "SMSH"
+#define SK_MESH_CACHE_VERSION 2
+
+typedef struct skMeshCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u32 vertexSize; // sizeof(skVertex), a layout change invalidates
+    u32 meshCount;
+    u32 boneCount;
+    u32 boneBoundsCount;
+    u32 loadedTextureCount;
+    u32 nameBytes;
+    u64 sourceSize;
+    i64 sourceTime;
+    u64 sourceHash;
+    f32 unskinnedBounds[2][3];
+} skMeshCacheHeader;
+
+typedef struct skMeshCacheMesh
+{
+    u32 vertexCount;
+    u32 indexCount;
+    u32 textureCount;
+} skMeshCacheMesh;
+
+typedef struct skMeshCacheBone
+{
+    i32 id;
+    u32 nameOffset; // Into the names at the end of the file
+    f32 offset[16];
+} skMeshCacheBone;
+
+// Embedded textures point into the Assimp scene, models that have
+// them aren't cooked
+typedef struct skMeshCacheTexture
+{
+    char type[64];
+    char path[128];
+} skMeshCacheTexture;
+
+static void skModel_CachePath(const skModel* model, char* dest,
+                              size_t size)
+{
+    snprintf(dest, size, "%s.skmesh", model->path);
+}
+
+// FNV-1a over the whole file, 0 if it can't be read
+static u64 skModel_HashFile(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    u64           hash = 14695981039346656037ULL;
+    unsigned char buffer[16384];
+    size_t        read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        for (size_t i = 0; i < read; i++)
+        {
+            hash ^= buffer[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    fclose(file);
+    return hash;
+}
+
+static skVector* skModel_VectorFromData(const void* data,
+                                        size_t elemSize, size_t count)
+{
+    skVector* vector =
+        skVector_Create(elemSize, count > 0 ? count : 1);
+    memcpy(vector->data, data, count * elemSize);
+    vector->size = count;
+    return vector;
+}
+
+static void skModel_CacheTextures(skVector* textures,
+                                  const skMeshCacheTexture* cached,
+                                  u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        skTexture texture = {0};
+        memcpy(texture.type, cached[i].type, sizeof(texture.type));
+        memcpy(texture.path, cached[i].path, sizeof(texture.path));
+        texture.type[sizeof(texture.type) - 1] = '\0';
+        texture.path[sizeof(texture.path) - 1] = '\0';
+        skVector_PushBack(textures, &texture);
+    }
+}
+
+// Fills the empty model from its cooked file if it's there and was
+// cooked from the source file as it is now. The size and time are
+// enough to trust it, when they changed but the contents didn't (a
+// fresh checkout) the new time is written back
+static bool skModel_LoadCooked(skModel* model)
+{
+    struct stat source;
+    if (stat(model->path, &source) != 0)
+        return false;
+
+    char cachePath[256];
+    skModel_CachePath(model, cachePath, sizeof(cachePath));
+
+    FILE* file = fopen(cachePath, "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    skMeshCacheHeader header;
+    if (length < (long)sizeof(header) ||
+        fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != SK_MESH_CACHE_MAGIC ||
+        header.version != SK_MESH_CACHE_VERSION ||
+        header.vertexSize != sizeof(skVertex) ||
+        header.sourceSize != (u64)source.st_size)
+    {
+        fclose(file);
+        return false;
+    }
+
+    bool touched = header.sourceTime != (i64)source.st_mtime;
+    if (touched && header.sourceHash != skModel_HashFile(model->path))
+    {
+        fclose(file);
+        return false;
+    }
+
+    // The rest in one read
+    size_t size = (size_t)length - sizeof(header);
+    u8*    data = (u8*)malloc(size > 0 ? size : 1);
+    bool   read = fread(data, 1, size, file) == size;
+    fclose(file);
+
+    // Every count is checked against the size before building
+    size_t meshTable = header.meshCount * sizeof(skMeshCacheMesh);
+    if (!read || meshTable > size)
+    {
+        free(data);
+        return false;
+    }
+
+    const skMeshCacheMesh* meshes = (const skMeshCacheMesh*)data;
+
+    size_t expected =
+        meshTable + header.boneCount * sizeof(skMeshCacheBone) +
+        header.boneBoundsCount * sizeof(skBoneBounds) +
+        header.loadedTextureCount * sizeof(skMeshCacheTexture) +
+        header.nameBytes;
+    for (u32 i = 0; i < header.meshCount; i++)
+    {
+        expected += meshes[i].vertexCount * sizeof(skVertex) +
+                    meshes[i].indexCount * sizeof(u32) +
+                    meshes[i].textureCount *
+                        sizeof(skMeshCacheTexture);
+    }
+
+    const char* names = (const char*)data + size - header.nameBytes;
+    if (expected != size ||
+        (header.nameBytes > 0 && names[header.nameBytes - 1] != '\0'))
+    {
+        free(data);
+        return false;
+    }
+
+    const u8* cursor = data + meshTable;
+
+    for (u32 i = 0; i < header.boneCount; i++)
+    {
+        skMeshCacheBone bone;
+        memcpy(&bone, cursor, sizeof(bone));
+        cursor += sizeof(bone);
+
+        if (bone.nameOffset >= header.nameBytes)
+            continue;
+
+        skBoneInfo info;
+        info.id = bone.id;
+        info.name = skStringID_Intern(names + bone.nameOffset);
+        memcpy(info.offset, bone.offset, sizeof(bone.offset));
+        skMap_Insert(model->boneInfoMap, &info.name, &info);
+    }
+    model->boneCount = (int)header.boneCount;
+
+    // Copied one at a time, the file doesn't keep the mat4 alignment
+    for (u32 i = 0; i < header.boneBoundsCount; i++)
+    {
+        skBoneBounds bounds;
+        memcpy(&bounds, cursor, sizeof(bounds));
+        cursor += sizeof(bounds);
+        skVector_PushBack(model->boneBounds, &bounds);
+    }
+    memcpy(model->unskinnedBounds, header.unskinnedBounds,
+           sizeof(header.unskinnedBounds));
+
+    skModel_CacheTextures(model->loadedTextures,
+                          (const skMeshCacheTexture*)cursor,
+                          header.loadedTextureCount);
+    cursor += header.loadedTextureCount * sizeof(skMeshCacheTexture);
+
+    for (u32 i = 0; i < header.meshCount; i++)
+    {
+        skVector* vertices = skModel_VectorFromData(
+            cursor, sizeof(skVertex), meshes[i].vertexCount);
+        cursor += meshes[i].vertexCount * sizeof(skVertex);
+
+        skVector* indices = skModel_VectorFromData(
+            cursor, sizeof(u32), meshes[i].indexCount);
+        cursor += meshes[i].indexCount * sizeof(u32);
+
+        skVector* textures = skVector_Create(
+            sizeof(skTexture),
+            meshes[i].textureCount > 0 ? meshes[i].textureCount : 1);
+        skModel_CacheTextures(textures,
+                              (const skMeshCacheTexture*)cursor,
+                              meshes[i].textureCount);
+        cursor += meshes[i].textureCount * sizeof(skMeshCacheTexture);
+
+        skMesh mesh = skMesh_Create(vertices, indices, textures);
+        skVector_PushBack(model->meshes, &mesh);
+    }
+
+    free(data);
+
+    if (touched)
+    {
+        file = fopen(cachePath, "r+b");
+        if (file)
+        {
+            header.sourceTime = (i64)source.st_mtime;
+            fwrite(&header, sizeof(header), 1, file);
+            fclose(file);
+        }
+    }
+
+    return true;
+}
+
+static void skModel_WriteTextures(FILE* file, skVector* textures)
+{
+    for (size_t i = 0; i < textures->size; i++)
+    {
+        skTexture* texture = (skTexture*)skVector_Get(textures, i);
+
+        skMeshCacheTexture cached = {0};
+        memcpy(cached.type, texture->type, sizeof(cached.type));
+        memcpy(cached.path, texture->path, sizeof(cached.path));
+        fwrite(&cached, sizeof(cached), 1, file);
+    }
+}
+
+// Writes the freshly imported model's cooked file
+static void skModel_Cook(skModel* model)
+{
+    for (size_t i = 0; i < model->loadedTextures->size; i++)
+    {
+        skTexture* texture =
+            (skTexture*)skVector_Get(model->loadedTextures, i);
+        if (texture->path[0] == '*')
+            return;
+    }
+
+    struct stat source;
+    if (stat(model->path, &source) != 0)
+        return;
+
+    skMeshCacheHeader header = {0};
+    header.magic = SK_MESH_CACHE_MAGIC;
+    header.version = SK_MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(skVertex);
+    header.meshCount = (u32)model->meshes->size;
+    header.boneBoundsCount = (u32)model->boneBounds->size;
+    header.loadedTextureCount = (u32)model->loadedTextures->size;
+    header.sourceSize = (u64)source.st_size;
+    header.sourceTime = (i64)source.st_mtime;
+    header.sourceHash = skModel_HashFile(model->path);
+    memcpy(header.unskinnedBounds, model->unskinnedBounds,
+           sizeof(header.unskinnedBounds));
+
+    skMap* boneInfoMap = model->boneInfoMap;
+    for (size_t i = 0; i < boneInfoMap->capacity; i++)
+    {
+        skBoneInfo* info =
+            (skBoneInfo*)skMap_SlotValue(boneInfoMap, i);
+        if (!info)
+            continue;
+
+        header.boneCount++;
+        header.nameBytes +=
+            (u32)strlen(skStringID_String(info->name)) + 1;
+    }
+
+    char cachePath[256];
+    skModel_CachePath(model, cachePath, sizeof(cachePath));
+
+    FILE* file = fopen(cachePath, "wb");
+    if (!file)
+    {
+        printf("SK ERROR: Failed to write %s\n", cachePath);
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (size_t i = 0; i < model->meshes->size; i++)
+    {
+        skMesh* mesh = (skMesh*)skVector_Get(model->meshes, i);
+
+        skMeshCacheMesh cached;
+        cached.vertexCount = (u32)mesh->vertices->size;
+        cached.indexCount = (u32)mesh->indices->size;
+        cached.textureCount = (u32)mesh->textures->size;
+        fwrite(&cached, sizeof(cached), 1, file);
+    }
+
+    u32 nameOffset = 0;
+    for (size_t i = 0; i < boneInfoMap->capacity; i++)
+    {
+        skBoneInfo* info =
+            (skBoneInfo*)skMap_SlotValue(boneInfoMap, i);
+        if (!info)
+            continue;
+
+
+        skMeshCacheBone bone;
+        bone.id = info->id;
+        bone.nameOffset = nameOffset;
+        memcpy(bone.offset, info->offset, sizeof(bone.offset));
+        fwrite(&bone, sizeof(bone), 1, file);
+
+        nameOffset += (u32)strlen(skStringID_String(info->name)) + 1;
+    }
+
+    fwrite(model->boneBounds->data, sizeof(skBoneBounds),
+           model->boneBounds->size, file);
+    skModel_WriteTextures(file, model->loadedTextures);
+
+    for (size_t i = 0; i < model->meshes->size; i++)
+    {
+        skMesh* mesh = (skMesh*)skVector_Get(model->meshes, i);
+        fwrite(mesh->vertices->data, sizeof(skVertex),
+               mesh->vertices->size, file);
+        fwrite(mesh->indices->data, sizeof(u32), mesh->indices->size,
+               file);
+        skModel_WriteTextures(file, mesh->textures);
+    }
+
+    for (size_t i = 0; i < boneInfoMap->capacity; i++)
+    {
+        skBoneInfo* info =
+            (skBoneInfo*)skMap_SlotValue(boneInfoMap, i);
+        if (!info)
+            continue;
+
+        const char* name = skStringID_String(info->name);
+        fwrite(name, 1, strlen(name) + 1, file);
+    }
+
+    fclose(file);
+}
+
 void skModel_Load(skModel* model, const char* path)
 {
     strcpy(model->path, path);
@@ -82,6 +457,10 @@ void skModel_Load(skModel* model, const char* path)
         model->directory[0] = '\0';
     }
 
+    // A cooked copy of the meshes skips Assimp entirely
+    if (skModel_LoadCooked(model))
+        return;
+
     // Read file via ASSIMP
     const struct aiScene* scene = aiImportFile(
         path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
@@ -100,6 +479,8 @@ void skModel_Load(skModel* model, const char* path)
 
     // Process ASSIMP's root node recursively
     skModel_ProcessNode(model, scene->mRootNode, scene);
+
+    skModel_Cook(model);
 }
 
 // Process node recursively
@@ -134,77 +515,208 @@ void skSetVertexBoneDataToDefault(skVertex* vertex)
 
 void skSetVertexBoneData(skVertex* vertex, int id, float weight)
 {
+    if (weight <= 0.0f)
+        return;
+
+    // The slots are kept heaviest first, so the new influence goes
+    // before the first lighter one and the lightest falls off the end
+    int slot = 0;
+    while (slot < SK_MAX_BONE_INFLUENCE &&
+           vertex->boneIDs[slot] >= 0 &&
+           vertex->weights[slot] >= weight)
+    {
+        slot++;
+    }
+
+    if (slot == SK_MAX_BONE_INFLUENCE)
+        return;
+
+    for (int i = SK_MAX_BONE_INFLUENCE - 1; i > slot; i--)
+    {
+        vertex->boneIDs[i] = vertex->boneIDs[i - 1];
+        vertex->weights[i] = vertex->weights[i - 1];
+    }
+
+    vertex->boneIDs[slot] = id;
+    vertex->weights[slot] = weight;
+}
+
+void skNormalizeVertexBoneData(skVertex* vertex)
+{
+    if (vertex->boneIDs[0] < 0)
+        return;
+
+    float total = 0.0f;
+    for (int i = 0; i < SK_MAX_BONE_INFLUENCE; i++)
+    {
+        if (vertex->boneIDs[i] >= 0)
+            total += vertex->weights[i];
+    }
+
+    // The shader treats a -1 as a vertex without bones, unused slots
+    // repeat the heaviest bone with no weight instead
     for (int i = 0; i < SK_MAX_BONE_INFLUENCE; i++)
     {
         if (vertex->boneIDs[i] < 0)
         {
-            vertex->boneIDs[i] = id;
-            vertex->weights[i] = weight;
+            vertex->boneIDs[i] = vertex->boneIDs[0];
+            vertex->weights[i] = 0.0f;
+        }
+        else
+        {
+            vertex->weights[i] /= total;
         }
     }
 }
 
-// Process mesh
-skMesh skModel_ProcessMesh(skModel* model, struct aiMesh* mesh,
-                           const struct aiScene* scene)
+// Meshes are converted in ranges of this many vertices or faces, big
+// ones split over the job system
+#define SK_MESH_CONVERT_GRAIN 16384
+
+typedef struct skMeshConversion
 {
-    skVector* vertices; // Vector of Vertex
-    skVector* indices;  // Vector of unsigned int
-    skVector* textures; // Vector of Texture
+    const struct aiMesh* mesh;
+    skVertex*            vertices;
+    u32*                 indices;
+} skMeshConversion;
 
-    // Initialize vectors
-    vertices = skVector_Create(sizeof(skVertex), 10);
-    indices = skVector_Create(sizeof(uint32_t), 10);
-    textures = skVector_Create(sizeof(skTexture), 2);
+static void skModel_ConvertVertices(void* userdata, size_t begin,
+                                    size_t end, int thread)
+{
+    (void)thread;
+    const skMeshConversion* conversion =
+        (const skMeshConversion*)userdata;
+
+    const struct aiMesh*     mesh = conversion->mesh;
+    const struct aiVector3D* positions = mesh->mVertices;
+    const struct aiVector3D* normals = mesh->mNormals;
+    const struct aiVector3D* uvs = mesh->mTextureCoords[0];
+    const struct aiVector3D* tangents = mesh->mTangents;
+    const struct aiVector3D* bitangents = mesh->mBitangents;
+
+    // Whatever the mesh doesn't have is left zero
+    skVertex* vertices = conversion->vertices;
+    memset(vertices + begin, 0, (end - begin) * sizeof(skVertex));
 
-    // Process vertices
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+    for (size_t i = begin; i < end; i++)
     {
-        skVertex vertex;
+        skVertex* vertex = &vertices[i];
 
-        skSetVertexBoneDataToDefault(&vertex);
+        vertex->position[0] = positions[i].x;
+        vertex->position[1] = positions[i].y;
+        vertex->position[2] = positions[i].z;
 
-        // Position
-        skAssimpVec3ToGLM(&mesh->mVertices[i], vertex.position);
+        if (normals)
+        {
+            vertex->normal[0] = normals[i].x;
+            vertex->normal[1] = normals[i].y;
+            vertex->normal[2] = normals[i].z;
+        }
 
-        // Normal
-        if (mesh->mNormals)
+        if (uvs)
         {
-            skAssimpVec3ToGLM(&mesh->mNormals[i], vertex.normal);
+            vertex->textureCoordinates[0] = uvs[i].x;
+            vertex->textureCoordinates[1] = uvs[i].y;
         }
 
-        if (mesh->mTextureCoords[0]) // Check if texture coordinates
-                                     // exist
+        if (uvs && tangents && bitangents)
         {
-            vertex.textureCoordinates[0] =
-                mesh->mTextureCoords[0][i].x;
-            vertex.textureCoordinates[1] =
-                mesh->mTextureCoords[0][i].y;
-
-            vertex.tangent[0] = mesh->mTangents[i].x;
-            vertex.tangent[1] = mesh->mTangents[i].y;
-            vertex.tangent[2] = mesh->mTangents[i].z;
-
-            vertex.bitangent[0] = mesh->mBitangents[i].x;
-            vertex.bitangent[1] = mesh->mBitangents[i].y;
-            vertex.bitangent[2] = mesh->mBitangents[i].z;
+            vertex->tangent[0] = tangents[i].x;
+            vertex->tangent[1] = tangents[i].y;
+            vertex->tangent[2] = tangents[i].z;
+
+            vertex->bitangent[0] = bitangents[i].x;
+            vertex->bitangent[1] = bitangents[i].y;
+            vertex->bitangent[2] = bitangents[i].z;
         }
-        else
+
+        for (int k = 0; k < SK_MAX_BONE_INFLUENCE; k++)
         {
-            vertex.textureCoordinates[0] = 0.0f;
-            vertex.textureCoordinates[1] = 0.0f;
+            vertex->boneIDs[k] = -1;
         }
+    }
+}
+
+// Only for meshes that are all triangles, face i's indices go at 3i
+static void skModel_ConvertTriangles(void* userdata, size_t begin,
+                                     size_t end, int thread)
+{
+    (void)thread;
+    const skMeshConversion* conversion =
+        (const skMeshConversion*)userdata;
+
+    const struct aiFace* faces = conversion->mesh->mFaces;
+    u32*                 indices = conversion->indices;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        const unsigned int* face = faces[i].mIndices;
+        indices[i * 3 + 0] = face[0];
+        indices[i * 3 + 1] = face[1];
+        indices[i * 3 + 2] = face[2];
+    }
+}
+
+// Process mesh
+skMesh skModel_ProcessMesh(skModel* model, struct aiMesh* mesh,
+                           const struct aiScene* scene)
+{
+    skVector* vertices; // Vector of Vertex
+    skVector* indices;  // Vector of unsigned int
+    skVector* textures; // Vector of Texture
 
-        skVector_PushBack(vertices, (void*)&vertex);
+    // Triangulating leaves lines and points alone, so the faces are
+    // counted unless the mesh is known to be only triangles
+    unsigned int otherTypes = aiPrimitiveType_POINT |
+                              aiPrimitiveType_LINE |
+                              aiPrimitiveType_POLYGON;
+    bool triangles =
+        (mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) &&
+        !(mesh->mPrimitiveTypes & otherTypes);
+
+    size_t indexCount = (size_t)mesh->mNumFaces * 3;
+    if (!triangles)
+    {
+        indexCount = 0;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            indexCount += mesh->mFaces[i].mNumIndices;
+        }
     }
 
-    // Process indices
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    // Sized for the whole mesh up front, then filled in place
+    size_t vertexCount = mesh->mNumVertices;
+    vertices = skVector_Create(sizeof(skVertex),
+                               vertexCount ? vertexCount : 1);
+    indices = skVector_Create(sizeof(uint32_t),
+                              indexCount ? indexCount : 1);
+    textures = skVector_Create(sizeof(skTexture), 2);
+
+    vertices->size = vertexCount;
+    indices->size = indexCount;
+
+    skMeshConversion conversion = {mesh, (skVertex*)vertices->data,
+                                   (u32*)indices->data};
+
+    skJobSystem_ParallelFor(vertexCount, SK_MESH_CONVERT_GRAIN,
+                            skModel_ConvertVertices, &conversion);
+
+    if (triangles)
     {
-        struct aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
+        skJobSystem_ParallelFor(mesh->mNumFaces,
+                                SK_MESH_CONVERT_GRAIN,
+                                skModel_ConvertTriangles,
+                                &conversion);
+    }
+    else
+    {
+        u32* index = conversion.indices;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            skVector_PushBack(indices, (void*)&face.mIndices[j]);
+            const struct aiFace* face = &mesh->mFaces[i];
+            memcpy(index, face->mIndices,
+                   face->mNumIndices * sizeof(u32));
+            index += face->mNumIndices;
         }
     }
 
@@ -316,6 +828,27 @@ void skModel_Destroy(skModel* model)
     skVector_Free(model->meshes);
     skVector_Free(model->loadedTextures);
     skMap_Free(model->boneInfoMap);
+    skVector_Free(model->boneBounds);
+}
+
+static void skBounds_Expand(vec3 box[2], vec3 point)
+{
+    glm_vec3_minv(box[0], point, box[0]);
+    glm_vec3_maxv(box[1], point, box[1]);
+}
+
+// The bounds of the bone, adding empty ones up to it if it's new
+static skBoneBounds* skModel_GetBoneBounds(skModel* model, int boneID)
+{
+    while ((int)model->boneBounds->size <= boneID)
+    {
+        skBoneBounds bounds;
+        glm_aabb_invalidate(bounds.box);
+        glm_mat4_identity(bounds.boneToMesh);
+        skVector_PushBack(model->boneBounds, &bounds);
+    }
+
+    return (skBoneBounds*)skVector_Get(model->boneBounds, boneID);
 }
 
 void skModel_ExtractBoneWeightForVertices(skModel*       model,
@@ -325,13 +858,18 @@ void skModel_ExtractBoneWeightForVertices(skModel*       model,
 {
     for (int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex)
     {
-        int         boneID = -1;
-        const char* boneName = mesh->mBones[boneIndex]->mName.data;
+        int        boneID = -1;
+        skStringID boneName =
+            skStringID_Intern(mesh->mBones[boneIndex]->mName.data);
+
+        skBoneInfo* boneInfo =
+            (skBoneInfo*)skMap_Get(model->boneInfoMap, &boneName);
 
-        if (!skMap_Contains(model->boneInfoMap, &boneName))
+        if (!boneInfo)
         {
             skBoneInfo newBoneInfo;
             newBoneInfo.id = model->boneCount;
+            newBoneInfo.name = boneName;
             skAssimpMat4ToGLM(&mesh->mBones[boneIndex]->mOffsetMatrix,
                               newBoneInfo.offset);
 
@@ -342,8 +880,6 @@ void skModel_ExtractBoneWeightForVertices(skModel*       model,
         }
         else
         {
-            skBoneInfo* boneInfo =
-                (skBoneInfo*)skMap_Get(model->boneInfoMap, &boneName);
             boneID = boneInfo->id;
         }
 
@@ -352,6 +888,12 @@ void skModel_ExtractBoneWeightForVertices(skModel*       model,
             mesh->mBones[boneIndex]->mWeights;
         int numWeights = mesh->mBones[boneIndex]->mNumWeights;
 
+        skBoneBounds* bounds = skModel_GetBoneBounds(model, boneID);
+        mat4          offset;
+        skAssimpMat4ToGLM(&mesh->mBones[boneIndex]->mOffsetMatrix,
+                          offset);
+        glm_mat4_inv(offset, bounds->boneToMesh);
+
         for (int weightIndex = 0; weightIndex < numWeights;
              ++weightIndex)
         {
@@ -361,6 +903,203 @@ void skModel_ExtractBoneWeightForVertices(skModel*       model,
             skVertex* vert =
                 (skVertex*)skVector_Get(vertices, vertexId);
             skSetVertexBoneData(vert, boneID, weight);
+
+            // A blend of bones stays inside the boxes of the bones
+            // it blends, so every vertex a bone moves at all counts
+            if (weight > 0.0f)
+            {
+                vec3 position;
+                glm_mat4_mulv3(offset, vert->position, 1.0f,
+                               position);
+                skBounds_Expand(bounds->box, position);
+            }
         }
     }
+
+    for (size_t i = 0; i < vertices->size; i++)
+    {
+        skVertex* vert = (skVertex*)skVector_Get(vertices, i);
+        if (vert->boneIDs[0] < 0)
+            skBounds_Expand(model->unskinnedBounds, vert->position);
+        else
+            skNormalizeVertexBoneData(vert);
+    }
+}
+
+void skModel_GetPoseBounds(skModel* model, const mat4* boneMatrices,
+                           int boneCount, vec3 dest[2])
+{
+    glm_vec3_copy(model->unskinnedBounds[0], dest[0]);
+    glm_vec3_copy(model->unskinnedBounds[1], dest[1]);
+
+    skBoneBounds* bounds = (skBoneBounds*)model->boneBounds->data;
+    int count = (int)model->boneBounds->size;
+    if (boneCount < count)
+        count = boneCount;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!glm_aabb_isvalid(bounds[i].box))
+            continue;
+
+        // The final matrix already holds the offset, undo it to move
+        // the box from bone space
+        mat4 boneToModel;
+        vec3 box[2];
+        glm_mat4_mul((vec4*)boneMatrices[i], bounds[i].boneToMesh,
+                     boneToModel);
+        glm_aabb_transform(bounds[i].box, boneToModel, box);
+        glm_aabb_merge(dest, box, dest);
+    }
+}
+
+// skStringID, skModelAsset*, the loaded models by normalized path
+static skMap* skModelAsset_registry;
+
+// Forward slashes, no empty or "." parts and ".." applied where it
+// can be, so two spellings of the same file share a model
+static void skModelAsset_NormalizePath(const char* path, char* dest,
+                                       size_t size)
+{
+    const char* parts[64];
+    int         lengths[64];
+    int         count = 0;
+    int         kept = 0; // Leading ".." parts, nothing to remove
+
+    bool absolute = path[0] == '/' || path[0] == '\\';
+
+    while (*path)
+    {
+        const char* part = path;
+        while (*path && *path != '/' && *path != '\\')
+            path++;
+
+        int length = (int)(path - part);
+        if (*path)
+            path++;
+
+        if (length == 0 || (length == 1 && part[0] == '.'))
+            continue;
+
+        bool parent = length == 2 && part[0] == '.' && part[1] == '.';
+        if (parent && count > kept)
+        {
+            count--;
+            continue;
+        }
+
+        if (count == 64)
+            break;
+
+        if (parent)
+            kept++;
+
+        parts[count] = part;
+        lengths[count] = length;
+        count++;
+    }
+
+    int used = snprintf(dest, size, "%s", absolute ? "/" : "");
+    for (int i = 0; i < count && used < (int)size; i++)
+    {
+        used += snprintf(dest + used, size - used, "%s%.*s",
+                         i > 0 ? "/" : "", lengths[i], parts[i]);
+    }
+}
+
+static void skModelAsset_LoadJob(void* userdata)
+{
+    skModelAsset* asset = (skModelAsset*)userdata;
+    skModel_Load(&asset->model, skStringID_String(asset->path));
+}
+
+static skModelAsset* skModelAsset_Get(const char* path, bool async)
+{
+    if (!skModelAsset_registry)
+    {
+        skModelAsset_registry = skMap_Create(
+            sizeof(skStringID), sizeof(skModelAsset*), 16,
+            skMap_IntHash, skMap_IntCompare);
+    }
+
+    char normalized[256];
+    skModelAsset_NormalizePath(path, normalized, sizeof(normalized));
+    skStringID id = skStringID_Intern(normalized);
+
+    skModelAsset** cached =
+        (skModelAsset**)skMap_Get(skModelAsset_registry, &id);
+    skModelAsset* asset = cached ? *cached : NULL;
+
+    if (!asset)
+    {
+        asset = (skModelAsset*)malloc(sizeof(skModelAsset));
+        asset->model = skModel_Create();
+        asset->path = id;
+        asset->refCount = 0;
+        asset->loading = NULL;
+        skMap_Insert(skModelAsset_registry, &id, &asset);
+
+        // Only the asset's own model is touched while it loads
+        if (async)
+        {
+            asset->loading = skJobGroup_Create();
+            skJobGroup_Run(asset->loading, skModelAsset_LoadJob,
+                           asset);
+        }
+        else
+        {
+            skModel_Load(&asset->model, normalized);
+        }
+    }
+
+    asset->refCount++;
+    return asset;
+}
+
+skModelAsset* skModelAsset_Acquire(const char* path)
+{
+    skModelAsset* asset = skModelAsset_Get(path, false);
+    skModelAsset_Wait(asset);
+    return asset;
+}
+
+skModelAsset* skModelAsset_AcquireAsync(const char* path)
+{
+    return skModelAsset_Get(path, true);
+}
+
+void skModelAsset_Wait(skModelAsset* asset)
+{
+    if (!asset->loading)
+        return;
+
+    skJobGroup_Free(asset->loading);
+    asset->loading = NULL;
+}
+
+void skModelAsset_Release(skModelAsset* asset)
+{
+    if (asset && asset->refCount > 0)
+        asset->refCount--;
+}
+
+void skModelAsset_Collect(void)
+{
+    if (!skModelAsset_registry)
+        return;
+
+    skMap* registry = skModelAsset_registry;
+    for (size_t i = 0; i < registry->capacity; i++)
+    {
+        skModelAsset** slot =
+            (skModelAsset**)skMap_SlotValue(registry, i);
+        if (!slot || (*slot)->refCount > 0)
+            continue;
+
+        skModelAsset* asset = *slot;
+        skModelAsset_Wait(asset);
+        skMap_Remove(registry, &asset->path);
+        skModel_Destroy(&asset->model);
+        free(asset);
+    }
 }
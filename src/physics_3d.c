@@ -463,21 +463,39 @@ void skPhysics3DState_DestroyBody(skPhysics3DState* state,
     skVector_Remove(renderer->lineObjects, body->lineIndex);
 }
 
-void skRigidbody3D_Sys(skECSState* state)
+static skECSQuery rigidbody3DQuery = NULL;
+
+// Copies the body transforms of a range of rigidbodies over to their
+// render objects, ranges run in parallel on the job system. Bodies
+// that are asleep or static haven't moved, so they're skipped unless
+// the rigidbody changed (its body was just created)
+static void skRigidbody3D_SyncRange(skECSQuery        query,
+                                    const skEntityID* entities,
+                                    size_t count, int thread,
+                                    void* userdata)
 {
-    SK_ECS_ITER_START(state->scene,
-                      SK_ECS_COMPONENT_TYPE(skRigidbody3D))
+    skECSState* state = (skECSState*)userdata;
+
+    for (size_t i = 0; i < count; i++)
     {
-        skRigidbody3D* rigid =
-            SK_ECS_GET(state->scene, _entity, skRigidbody3D);
-        skRenderAssociation* assoc =
-            SK_ECS_GET(state->scene, _entity, skRenderAssociation);
+        skRigidbody3D* rigid = SK_ECS_QUERY_GET(
+            query, entities[i], 0, skRigidbody3D);
 
         if (!rigid->created)
         {
             continue;
         }
 
+        if (!JPH_BodyInterface_IsActive(
+                state->physics3dState->bodyInterface, rigid->bodyID) &&
+            !skECS_QueryChanged(query, entities[i], 0))
+        {
+            continue;
+        }
+
+        skRenderAssociation* assoc = SK_ECS_QUERY_GET_MUT(
+            query, entities[i], 1, skRenderAssociation);
+
         JPH_RVec3 pos;
         JPH_Quat  rot;
         JPH_BodyInterface_GetPositionAndRotation(
@@ -544,7 +562,16 @@ void skRigidbody3D_Sys(skECSState* state)
         }
 #endif
     }
-    SK_ECS_ITER_END();
+}
+
+void skRigidbody3D_Sys(skECSState* state)
+{
+    SK_ECS_QUERY(rigidbody3DQuery, state->scene,
+                 SK_ECS_COMPONENT_TYPE(skRigidbody3D),
+                 SK_ECS_COMPONENT_TYPE(skRenderAssociation));
+
+    skECS_ParallelForEach(rigidbody3DQuery, skRigidbody3D_SyncRange,
+                          state, 0);
 }
 
 void skRigidbody3D_StartSys(skECSState* state)
@@ -557,11 +584,12 @@ void skRigidbody3D_StartSys(skECSState* state)
         skRenderAssociation* assoc =
             SK_ECS_GET(state->scene, _entity, skRenderAssociation);
 
-        skModel model = skModel_Create();
-        skModel_Load(&model, assoc->modelPath);
+        skModelAsset* asset = skModelAsset_Acquire(assoc->modelPath);
 
         skPhysics3DState_CreateBody(state->physics3dState, state,
-                                    rigid, assoc, &model);
+                                    rigid, assoc, &asset->model);
+        skModelAsset_Release(asset);
+        SK_ECS_MARK_CHANGED(state->scene, _entity, skRigidbody3D);
     }
     SK_ECS_ITER_END();
 }
@@ -8,12 +8,13 @@ void skRenderAssociation_CreateRenderObject(
 
     if (assoc->type == skRenderObjectType_Model)
     {
-        skModel model = skModel_Create();
-        skModel_Load(&model, assoc->modelPath);
+        skModelAsset* asset = skModelAsset_Acquire(assoc->modelPath);
 
         obj = skRenderObject_CreateFromModel(
-            state->renderer, &model, 0, assoc->texturePath,
+            state->renderer, &asset->model, 0, assoc->texturePath,
             assoc->normalTexturePath, assoc->roughnessTexturePath);
+
+        skModelAsset_Release(asset);
     }
     else if (assoc->type == skRenderObjectType_Sprite)
     {
@@ -36,6 +37,49 @@ void skRenderAssociation_CreateRenderObject(
 
 void skRenderAssociation_StartSys(skECSState* state)
 {
+    // Every model and image the scene uses starts loading on the job
+    // system before any is waited for, so they load side by side
+    skVector* models = skVector_Create(sizeof(skModelAsset*), 16);
+    skVector* images = skVector_Create(sizeof(skImageAsset*), 16);
+
+    SK_ECS_ITER_START(state->scene,
+                      SK_ECS_COMPONENT_TYPE(skRenderAssociation))
+    {
+        skRenderAssociation* assoc =
+            SK_ECS_GET(state->scene, _entity, skRenderAssociation);
+
+        if (assoc->type == skRenderObjectType_Model)
+        {
+            skModelAsset* model =
+                skModelAsset_AcquireAsync(assoc->modelPath);
+            skVector_PushBack(models, &model);
+        }
+
+        const char* paths[3] = {assoc->texturePath,
+                                assoc->normalTexturePath,
+                                assoc->roughnessTexturePath};
+        for (int i = 0; i < 3; i++)
+        {
+            skImageAsset* image = skImageAsset_AcquireAsync(paths[i]);
+            skVector_PushBack(images, &image);
+        }
+    }
+    SK_ECS_ITER_END();
+
+    skModelAsset** loadedModels = (skModelAsset**)models->data;
+    skImageAsset** loadedImages = (skImageAsset**)images->data;
+    for (size_t i = 0; i < models->size; i++)
+    {
+        skModelAsset_Wait(loadedModels[i]);
+    }
+    for (size_t i = 0; i < images->size; i++)
+    {
+        skImageAsset_Wait(loadedImages[i]);
+    }
+
+    // With everything in memory the GPU uploads go in one submit
+    skRenderer_BeginUploads(state->renderer);
+
     SK_ECS_ITER_START(state->scene,
                       SK_ECS_COMPONENT_TYPE(skRenderAssociation))
     {
@@ -45,4 +89,18 @@ void skRenderAssociation_StartSys(skECSState* state)
         skRenderAssociation_CreateRenderObject(assoc, state);
     }
     SK_ECS_ITER_END();
+
+    skRenderer_EndUploads(state->renderer);
+
+    for (size_t i = 0; i < models->size; i++)
+    {
+        skModelAsset_Release(loadedModels[i]);
+    }
+    for (size_t i = 0; i < images->size; i++)
+    {
+        skImageAsset_Release(loadedImages[i]);
+    }
+
+    skVector_Free(models);
+    skVector_Free(images);
 }
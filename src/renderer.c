@@ -1268,6 +1268,16 @@ void skRenderer_DrawFrame(skRenderer* renderer, skEditor* editor)
         *imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 
     skRenderer_UpdateUniformBuffers(renderer);
+
+    u32 skinnedObjects = 0;
+    for (size_t i = 0; i < renderer->renderObjects->size; i++)
+    {
+        skRenderObject* obj =
+            (skRenderObject*)skVector_Get(renderer->renderObjects, i);
+        if (obj->boneTransforms != NULL)
+            skinnedObjects++;
+    }
+    skRenderer_ReserveBonePalettes(renderer, skinnedObjects);
     
     skRenderer_RecordCommandBuffer(renderer, cmdBuffer, imageIndex,
                                    editor);
@@ -1382,24 +1392,29 @@ void skRenderer_RecordCommandBuffer(skRenderer*     renderer,
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
     
     size_t totalObjects = renderer->renderObjects->size;
+    char*  bonePalettes =
+        (char*)renderer->boneBuffersMap[renderer->currentFrame];
+    u32    paletteCount = 0;
     
     for (size_t i = 0; i < totalObjects; i++)
     {
         skRenderObject* obj =
             (skRenderObject*)skVector_Get(renderer->renderObjects, i);
 
+        // Objects without bones don't read their palette, they share
+        // the first one
+        u32 boneOffset = 0;
         if (obj->boneTransforms != NULL)
         {
-            for (int j = 0; j < 100; j++)
-            {
-                mat4* mat =
-                    (mat4*)skVector_Get(obj->boneTransforms, j);
-                memcpy(
-                    (char*)renderer
-                            ->boneBuffersMap[renderer->currentFrame] +
-                        (j * sizeof(mat4)),
-                    mat, sizeof(mat4));
-            }
+            size_t boneCount = obj->boneTransforms->size;
+            if (boneCount > SK_MAX_BONES)
+                boneCount = SK_MAX_BONES;
+
+            boneOffset =
+                (u32)(paletteCount++ * renderer->bonePaletteStride);
+            memcpy(bonePalettes + boneOffset,
+                   obj->boneTransforms->data,
+                   boneCount * sizeof(mat4));
         }
 
         // Bind vertex and index buffers for this object
@@ -1420,7 +1435,7 @@ void skRenderer_RecordCommandBuffer(skRenderer*     renderer,
         // Bind descriptor set for this object
         vkCmdBindDescriptorSets(
             commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            renderer->pipelineLayout, 0, 4, sets, 0, NULL);
+            renderer->pipelineLayout, 0, 4, sets, 1, &boneOffset);
 
         // Draw this object
         vkCmdDrawIndexed(commandBuffer, obj->indexCount, 1, 0, 0, 0);
@@ -1739,11 +1754,32 @@ void skRenderer_UpdateUniformBuffers(skRenderer* renderer)
                     0.001f, 1000.0f, proj);
     proj[1][1] *= -1.0f;
 
+    u32  frame = renderer->currentFrame;
+    bool cameraChanged =
+        memcmp(renderer->viewTransform, renderer->uploadedView[frame],
+               sizeof(mat4)) != 0 ||
+        memcmp(proj, renderer->uploadedProj[frame], sizeof(mat4)) != 0;
+
+    if (cameraChanged)
+    {
+        glm_mat4_copy(renderer->viewTransform,
+                      renderer->uploadedView[frame]);
+        glm_mat4_copy(proj, renderer->uploadedProj[frame]);
+    }
+
     for (size_t i = 0; i < renderer->renderObjects->size; i++)
     {
         skRenderObject* obj =
             (skRenderObject*)skVector_Get(renderer->renderObjects, i);
 
+        // Static objects only get uploaded when the camera moves
+        if (!cameraChanged &&
+            memcmp(obj->transform, obj->uploadedTransforms[frame],
+                   sizeof(mat4)) == 0)
+        {
+            continue;
+        }
+
         skUniformBufferObject ubo = {0};
 
         glm_mat4_copy(obj->transform, ubo.model);
@@ -1752,8 +1788,8 @@ void skRenderer_UpdateUniformBuffers(skRenderer* renderer)
 
         glm_mat4_copy(proj, ubo.proj);
 
-        memcpy(obj->uniformBuffersMap[renderer->currentFrame], &ubo,
-               sizeof(ubo));
+        memcpy(obj->uniformBuffersMap[frame], &ubo, sizeof(ubo));
+        glm_mat4_copy(obj->transform, obj->uploadedTransforms[frame]);
     }
 
     char* mapped =
@@ -2097,6 +2133,9 @@ void skRenderer_CreateBuffer(skRenderer* renderer, size_t size,
 VkCommandBuffer
 skRenderer_BeginSingleTimeCommands(skRenderer* renderer)
 {
+    if (renderer->uploadCommandBuffer != VK_NULL_HANDLE)
+        return renderer->uploadCommandBuffer;
+
     VkCommandBufferAllocateInfo allocInfo = {0};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -2119,6 +2158,10 @@ skRenderer_BeginSingleTimeCommands(skRenderer* renderer)
 void skRenderer_EndSingleTimeCommands(skRenderer*     renderer,
                                       VkCommandBuffer commandBuffer)
 {
+    // The batch is submitted when it ends
+    if (commandBuffer == renderer->uploadCommandBuffer)
+        return;
+
     vkEndCommandBuffer(commandBuffer);
 
     VkSubmitInfo submitInfo = {0};
@@ -2134,6 +2177,55 @@ void skRenderer_EndSingleTimeCommands(skRenderer*     renderer,
                          &commandBuffer);
 }
 
+void skRenderer_BeginUploads(skRenderer* renderer)
+{
+    if (renderer->uploadCommandBuffer != VK_NULL_HANDLE)
+        return;
+
+    if (!renderer->uploadStagingBuffers)
+    {
+        renderer->uploadStagingBuffers =
+            skVector_Create(sizeof(skStagingBuffer), 16);
+    }
+
+    renderer->uploadCommandBuffer =
+        skRenderer_BeginSingleTimeCommands(renderer);
+}
+
+void skRenderer_EndUploads(skRenderer* renderer)
+{
+    VkCommandBuffer commandBuffer = renderer->uploadCommandBuffer;
+    if (commandBuffer == VK_NULL_HANDLE)
+        return;
+
+    renderer->uploadCommandBuffer = VK_NULL_HANDLE;
+    skRenderer_EndSingleTimeCommands(renderer, commandBuffer);
+
+    for (size_t i = 0; i < renderer->uploadStagingBuffers->size; i++)
+    {
+        skStagingBuffer* staging = (skStagingBuffer*)skVector_Get(
+            renderer->uploadStagingBuffers, i);
+        vkDestroyBuffer(renderer->device, staging->buffer, NULL);
+        vkFreeMemory(renderer->device, staging->memory, NULL);
+    }
+    skVector_Clear(renderer->uploadStagingBuffers);
+}
+
+void skRenderer_DestroyStagingBuffer(skRenderer*    renderer,
+                                     VkBuffer       buffer,
+                                     VkDeviceMemory memory)
+{
+    if (renderer->uploadCommandBuffer != VK_NULL_HANDLE)
+    {
+        skStagingBuffer staging = {buffer, memory};
+        skVector_PushBack(renderer->uploadStagingBuffers, &staging);
+        return;
+    }
+
+    vkDestroyBuffer(renderer->device, buffer, NULL);
+    vkFreeMemory(renderer->device, memory, NULL);
+}
+
 void skRenderer_CopyBuffer(skRenderer* renderer, VkBuffer srcBuffer,
                            VkBuffer dstBuffer, VkDeviceSize size)
 {
@@ -2247,7 +2339,7 @@ void skRenderer_CreateDescriptorSetLayout(skRenderer* renderer)
     VkDescriptorSetLayoutBinding bonesBufferBinding = {0};
     bonesBufferBinding.binding = 0;
     bonesBufferBinding.descriptorType =
-        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     bonesBufferBinding.descriptorCount = 1;
     bonesBufferBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     bonesBufferBinding.pImmutableSamplers = NULL;
@@ -2267,25 +2359,96 @@ void skRenderer_CreateDescriptorSetLayout(skRenderer* renderer)
     }
 }
 
+static void skRenderer_CreateBoneBuffer(skRenderer* renderer,
+                                        u32 frame, u32 palettes)
+{
+    VkDeviceSize size = renderer->bonePaletteStride * palettes;
+
+    skRenderer_CreateBuffer(
+        renderer, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &renderer->boneBuffers[frame],
+        &renderer->boneBuffersMemory[frame]);
+
+    vkMapMemory(renderer->device, renderer->boneBuffersMemory[frame],
+                0, size, 0, &renderer->boneBuffersMap[frame]);
+
+    renderer->bonePaletteCapacity[frame] = palettes;
+}
+
+// Points the frame's bone descriptor set at one palette of its bone
+// buffer, the dynamic offset moves it
+static void skRenderer_WriteBoneDescriptorSet(skRenderer* renderer,
+                                              u32         frame)
+{
+    VkDescriptorBufferInfo bufferInfo = {0};
+    bufferInfo.buffer = renderer->boneBuffers[frame];
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(mat4) * SK_MAX_BONES;
+
+    VkWriteDescriptorSet descriptorWrites[] = {{0}};
+    descriptorWrites[0].sType =
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = renderer->boneDescriptorSets[frame];
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorType =
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(renderer->device, 1, descriptorWrites, 0,
+                           NULL);
+}
+
+void skRenderer_ReserveBonePalettes(skRenderer* renderer, u32 count)
+{
+    u32 frame = renderer->currentFrame;
+    u32 capacity = renderer->bonePaletteCapacity[frame];
+    if (count <= capacity)
+        return;
+
+    if (capacity == 0)
+        capacity = SK_BONE_PALETTES;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+
+    // The frame's fence was waited on so nothing uses these anymore,
+    // the other frames keep their own buffers
+    vkUnmapMemory(renderer->device,
+                  renderer->boneBuffersMemory[frame]);
+    vkDestroyBuffer(renderer->device, renderer->boneBuffers[frame],
+                    NULL);
+    vkFreeMemory(renderer->device, renderer->boneBuffersMemory[frame],
+                 NULL);
+
+    skRenderer_CreateBoneBuffer(renderer, frame, capacity);
+    skRenderer_WriteBoneDescriptorSet(renderer, frame);
+}
+
 void skRenderer_CreateDescriptorSets(skRenderer* renderer)
 {
     VkDeviceSize bufferSize = 48 * SK_MAX_LIGHTS;
-    VkDeviceSize boneSize = sizeof(mat4) * SK_MAX_BONES;
     VkDeviceSize uniformBufferSize =
         sizeof(skGlobalUniformBufferObject);
 
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(renderer->physicalDevice,
+                                  &properties);
+
+    VkDeviceSize alignment =
+        properties.limits.minStorageBufferOffsetAlignment;
+    VkDeviceSize paletteSize = sizeof(mat4) * SK_MAX_BONES;
+    renderer->bonePaletteStride =
+        (paletteSize + alignment - 1) / alignment * alignment;
+
     for (int frame = 0; frame < SK_FRAMES_IN_FLIGHT; frame++)
     {
-        skRenderer_CreateBuffer(
-            renderer, boneSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &renderer->boneBuffers[frame],
-            &renderer->boneBuffersMemory[frame]);
-
-        vkMapMemory(renderer->device,
-                    renderer->boneBuffersMemory[frame], 0, boneSize,
-                    0, &renderer->boneBuffersMap[frame]);
+        skRenderer_CreateBoneBuffer(renderer, frame,
+                                    SK_BONE_PALETTES);
 
         skRenderer_CreateBuffer(
             renderer, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
@@ -2380,25 +2543,7 @@ void skRenderer_CreateDescriptorSets(skRenderer* renderer)
     // Update descriptor sets
     for (int frame = 0; frame < SK_FRAMES_IN_FLIGHT; frame++)
     {
-        VkDescriptorBufferInfo bufferInfo = {0};
-        bufferInfo.buffer = renderer->boneBuffers[frame];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(mat4) * SK_MAX_BONES;
-
-        VkWriteDescriptorSet descriptorWrites[] = {{0}};
-        descriptorWrites[0].sType =
-            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet =
-            renderer->boneDescriptorSets[frame];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType =
-            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-        vkUpdateDescriptorSets(renderer->device, 1, descriptorWrites,
-                               0, NULL);
+        skRenderer_WriteBoneDescriptorSet(renderer, frame);
     }
 
     VkDescriptorSetLayout uniformLayouts[SK_FRAMES_IN_FLIGHT];
@@ -2489,8 +2634,8 @@ void skRenderer_CreateDescriptorPool(skRenderer* renderer)
     poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     poolSizes[2].descriptorCount =
         SK_MAX_LIGHTS * SK_FRAMES_IN_FLIGHT;
-    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[3].descriptorCount = SK_MAX_BONES * SK_FRAMES_IN_FLIGHT;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[3].descriptorCount = SK_FRAMES_IN_FLIGHT;
 
     VkDescriptorPoolCreateInfo poolInfo = {0};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -2725,14 +2870,16 @@ skRenderer skRenderer_Create(skWindow* window)
     skRenderer_CreateCommandBuffers(&renderer);
     skRenderer_CreateSyncObjects(&renderer);
 
-    skModel model = skModel_Create();
-    skModel_Load(&model, "res/models/sphere.fbx");
+    skModelAsset* sphere =
+        skModelAsset_Acquire("res/models/sphere.fbx");
 
     renderer.skyboxObject = skRenderObject_CreateFromModel(
-        &renderer, &model, 0, "res/textures/skybox.bmp",
+        &renderer, &sphere->model, 0, "res/textures/skybox.bmp",
         "res/textures/normal.bmp",
         "res/textures/default_roughness.bmp");
 
+    skModelAsset_Release(sphere);
+
     for (int frame = 0; frame < SK_FRAMES_IN_FLIGHT; frame++)
     {
         skRenderer_CreateBuffer(
@@ -2868,6 +3015,21 @@ void skRenderer_CreateTexture(skRenderer*    renderer,
     }
 }
 
+// The decoded image, or the fallback image if it can't be loaded
+static skImageAsset* skRenderer_AcquireTexture(const char* path,
+                                               const char* fallback)
+{
+    skImageAsset* image = skImageAsset_Acquire(path);
+    if (!image->pixels)
+    {
+        printf("SK ERROR: Failed to load texture image %s.\n", path);
+        skImageAsset_Release(image);
+        image = skImageAsset_Acquire(fallback);
+    }
+
+    return image;
+}
+
 skRenderObject
 skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
                                int meshIndex, const char* texturePath,
@@ -2912,8 +3074,8 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
     skRenderer_CopyBuffer(renderer, stagingBuffer, obj.vertexBuffer,
                           bufferSize);
 
-    vkDestroyBuffer(renderer->device, stagingBuffer, NULL);
-    vkFreeMemory(renderer->device, stagingMemory, NULL);
+    skRenderer_DestroyStagingBuffer(renderer, stagingBuffer,
+                                    stagingMemory);
 
     // Create index buffer
 
@@ -2946,25 +3108,18 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
     skRenderer_CopyBuffer(renderer, indexStagingBuffer,
                           obj.indexBuffer, indexBufferSize);
 
-    vkDestroyBuffer(renderer->device, indexStagingBuffer, NULL);
-    vkFreeMemory(renderer->device, indexStagingMemory, NULL);
+    skRenderer_DestroyStagingBuffer(renderer, indexStagingBuffer,
+                                    indexStagingMemory);
 
     // Create texture image
 
     {
 
-        int      texWidth, texHeight, texChannels;
-        stbi_uc* pixels =
-            stbi_load(texturePath, &texWidth, &texHeight,
-                      &texChannels, STBI_rgb_alpha);
-
-        if (!pixels)
-        {
-            printf("SK ERROR: Failed to load texture image.");
-            pixels =
-                stbi_load("res/textures/image.bmp", &texWidth,
-                          &texHeight, &texChannels, STBI_rgb_alpha);
-        }
+        skImageAsset* image = skRenderer_AcquireTexture(
+            texturePath, "res/textures/image.bmp");
+        int      texWidth = image->width;
+        int      texHeight = image->height;
+        stbi_uc* pixels = image->pixels;
 
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
@@ -2983,7 +3138,7 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
         memcpy(imageData, pixels, imageSize);
         vkUnmapMemory(renderer->device, imageStagingBufferMemory);
 
-        stbi_image_free(pixels);
+        skImageAsset_Release(image);
 
         skRenderer_CreateImage(
             renderer, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3005,6 +3160,8 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
             renderer, obj.textureImage, VK_FORMAT_R8G8B8A8_SRGB,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        skRenderer_DestroyStagingBuffer(renderer, imageStagingBuffer,
+                                        imageStagingBufferMemory);
 
         obj.textureImageView = skRenderer_CreateImageView(
             renderer, obj.textureImage, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3046,18 +3203,11 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
 
     {
 
-        int      texWidth, texHeight, texChannels;
-        stbi_uc* pixels =
-            stbi_load(normalTexturePath, &texWidth, &texHeight,
-                      &texChannels, STBI_rgb_alpha);
-
-        if (!pixels)
-        {
-            printf("SK ERROR: Failed to load texture image.");
-            pixels =
-                stbi_load("res/textures/normal.bmp", &texWidth,
-                          &texHeight, &texChannels, STBI_rgb_alpha);
-        }
+        skImageAsset* image = skRenderer_AcquireTexture(
+            normalTexturePath, "res/textures/normal.bmp");
+        int      texWidth = image->width;
+        int      texHeight = image->height;
+        stbi_uc* pixels = image->pixels;
 
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
@@ -3076,7 +3226,7 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
         memcpy(imageData, pixels, imageSize);
         vkUnmapMemory(renderer->device, imageStagingBufferMemory);
 
-        stbi_image_free(pixels);
+        skImageAsset_Release(image);
 
         skRenderer_CreateImage(
             renderer, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3098,6 +3248,8 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
             renderer, obj.normalImage, VK_FORMAT_R8G8B8A8_SRGB,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        skRenderer_DestroyStagingBuffer(renderer, imageStagingBuffer,
+                                        imageStagingBufferMemory);
 
         obj.normalImageView = skRenderer_CreateImageView(
             renderer, obj.normalImage, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3137,19 +3289,12 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
 
     {
 
-        int      texWidth, texHeight, texChannels;
-        stbi_uc* pixels =
-            stbi_load(roughnessTexturePath, &texWidth, &texHeight,
-                      &texChannels, STBI_rgb_alpha);
-
-        if (!pixels)
-        {
-            printf(
-                "SK ERROR: Failed to load roughness texture image.");
-            pixels = stbi_load("res/textures/default_roughness.bmp",
-                               &texWidth, &texHeight, &texChannels,
-                               STBI_rgb_alpha);
-        }
+        skImageAsset* image = skRenderer_AcquireTexture(
+            roughnessTexturePath,
+            "res/textures/default_roughness.bmp");
+        int      texWidth = image->width;
+        int      texHeight = image->height;
+        stbi_uc* pixels = image->pixels;
 
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
@@ -3168,7 +3313,7 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
         memcpy(imageData, pixels, imageSize);
         vkUnmapMemory(renderer->device, imageStagingBufferMemory);
 
-        stbi_image_free(pixels);
+        skImageAsset_Release(image);
 
         skRenderer_CreateImage(
             renderer, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3190,6 +3335,8 @@ skRenderObject_CreateFromModel(skRenderer* renderer, skModel* model,
             renderer, obj.roughnessImage, VK_FORMAT_R8G8B8A8_SRGB,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        skRenderer_DestroyStagingBuffer(renderer, imageStagingBuffer,
+                                        imageStagingBufferMemory);
 
         obj.roughnessImageView = skRenderer_CreateImageView(
             renderer, obj.roughnessImage, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3273,8 +3420,8 @@ skRenderObject skRenderObject_CreateFromSprite(
     skRenderer_CopyBuffer(renderer, vertexStagingBuffer,
                           obj.vertexBuffer, vertexBufferSize);
 
-    vkDestroyBuffer(renderer->device, vertexStagingBuffer, NULL);
-    vkFreeMemory(renderer->device, vertexStagingMemory, NULL);
+    skRenderer_DestroyStagingBuffer(renderer, vertexStagingBuffer,
+                                    vertexStagingMemory);
 
     // Create index buffer
 
@@ -3311,18 +3458,18 @@ skRenderObject skRenderObject_CreateFromSprite(
     skRenderer_CopyBuffer(renderer, indexStagingBuffer,
                           obj.indexBuffer, indexBufferSize);
 
-    vkDestroyBuffer(renderer->device, indexStagingBuffer, NULL);
-    vkFreeMemory(renderer->device, indexStagingMemory, NULL);
+    skRenderer_DestroyStagingBuffer(renderer, indexStagingBuffer,
+                                    indexStagingMemory);
 
     // Create texture image
 
     {
 
-        int      texWidth, texHeight, texChannels;
-        stbi_uc* pixels =
-            stbi_load(texturePath, &texWidth, &texHeight,
-                      &texChannels, STBI_rgb_alpha);
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
+        skImageAsset* image = skImageAsset_Acquire(texturePath);
+        int           texWidth = image->width;
+        int           texHeight = image->height;
+        stbi_uc*      pixels = image->pixels;
+        VkDeviceSize  imageSize = texWidth * texHeight * 4;
 
         if (!pixels)
         {
@@ -3344,7 +3491,7 @@ skRenderObject skRenderObject_CreateFromSprite(
         memcpy(imageData, pixels, imageSize);
         vkUnmapMemory(renderer->device, imageStagingBufferMemory);
 
-        stbi_image_free(pixels);
+        skImageAsset_Release(image);
 
         skRenderer_CreateImage(
             renderer, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3366,6 +3513,8 @@ skRenderObject skRenderObject_CreateFromSprite(
             renderer, obj.textureImage, VK_FORMAT_R8G8B8A8_SRGB,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        skRenderer_DestroyStagingBuffer(renderer, imageStagingBuffer,
+                                        imageStagingBufferMemory);
 
         obj.textureImageView = skRenderer_CreateImageView(
             renderer, obj.textureImage, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3407,18 +3556,11 @@ skRenderObject skRenderObject_CreateFromSprite(
 
     {
 
-        int      texWidth, texHeight, texChannels;
-        stbi_uc* pixels =
-            stbi_load(normalTexturePath, &texWidth, &texHeight,
-                      &texChannels, STBI_rgb_alpha);
-
-        if (!pixels)
-        {
-            printf("SK ERROR: Failed to load texture image.");
-            pixels =
-                stbi_load("res/textures/normal.bmp", &texWidth,
-                          &texHeight, &texChannels, STBI_rgb_alpha);
-        }
+        skImageAsset* image = skRenderer_AcquireTexture(
+            normalTexturePath, "res/textures/normal.bmp");
+        int      texWidth = image->width;
+        int      texHeight = image->height;
+        stbi_uc* pixels = image->pixels;
 
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
@@ -3437,7 +3579,7 @@ skRenderObject skRenderObject_CreateFromSprite(
         memcpy(imageData, pixels, imageSize);
         vkUnmapMemory(renderer->device, imageStagingBufferMemory);
 
-        stbi_image_free(pixels);
+        skImageAsset_Release(image);
 
         skRenderer_CreateImage(
             renderer, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3459,6 +3601,8 @@ skRenderObject skRenderObject_CreateFromSprite(
             renderer, obj.normalImage, VK_FORMAT_R8G8B8A8_SRGB,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        skRenderer_DestroyStagingBuffer(renderer, imageStagingBuffer,
+                                        imageStagingBufferMemory);
 
         obj.normalImageView = skRenderer_CreateImageView(
             renderer, obj.normalImage, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3498,19 +3642,12 @@ skRenderObject skRenderObject_CreateFromSprite(
 
     {
 
-        int      texWidth, texHeight, texChannels;
-        stbi_uc* pixels =
-            stbi_load(roughnessTexturePath, &texWidth, &texHeight,
-                      &texChannels, STBI_rgb_alpha);
-
-        if (!pixels)
-        {
-            printf(
-                "SK ERROR: Failed to load roughness texture image.");
-            pixels = stbi_load("res/textures/default_roughness.bmp",
-                               &texWidth, &texHeight, &texChannels,
-                               STBI_rgb_alpha);
-        }
+        skImageAsset* image = skRenderer_AcquireTexture(
+            roughnessTexturePath,
+            "res/textures/default_roughness.bmp");
+        int      texWidth = image->width;
+        int      texHeight = image->height;
+        stbi_uc* pixels = image->pixels;
 
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
@@ -3529,7 +3666,7 @@ skRenderObject skRenderObject_CreateFromSprite(
         memcpy(imageData, pixels, imageSize);
         vkUnmapMemory(renderer->device, imageStagingBufferMemory);
 
-        stbi_image_free(pixels);
+        skImageAsset_Release(image);
 
         skRenderer_CreateImage(
             renderer, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3551,6 +3688,8 @@ skRenderObject skRenderObject_CreateFromSprite(
             renderer, obj.roughnessImage, VK_FORMAT_R8G8B8A8_SRGB,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        skRenderer_DestroyStagingBuffer(renderer, imageStagingBuffer,
+                                        imageStagingBufferMemory);
 
         obj.roughnessImageView = skRenderer_CreateImageView(
             renderer, obj.roughnessImage, VK_FORMAT_R8G8B8A8_SRGB,
@@ -3628,8 +3767,8 @@ skLineObject skLineObject_Create(skRenderer* renderer, vec3* points,
     skRenderer_CopyBuffer(renderer, stagingBuffer, line.vertexBuffer,
                           bufferSize);
 
-    vkDestroyBuffer(renderer->device, stagingBuffer, NULL);
-    vkFreeMemory(renderer->device, stagingMemory, NULL);
+    skRenderer_DestroyStagingBuffer(renderer, stagingBuffer,
+                                    stagingMemory);
 
     size_t         indexBufferSize = sizeof(u32) * indexCount;
     VkBuffer       indexStagingBuffer;
@@ -3656,8 +3795,8 @@ skLineObject skLineObject_Create(skRenderer* renderer, vec3* points,
     skRenderer_CopyBuffer(renderer, indexStagingBuffer,
                           line.indexBuffer, indexBufferSize);
 
-    vkDestroyBuffer(renderer->device, indexStagingBuffer, NULL);
-    vkFreeMemory(renderer->device, indexStagingMemory, NULL);
+    skRenderer_DestroyStagingBuffer(renderer, indexStagingBuffer,
+                                    indexStagingMemory);
 
     for (int frame = 0; frame < SK_FRAMES_IN_FLIGHT; frame++)
     {
@@ -0,0 +1,271 @@
+#include <sulkan/skinning.h>
+#include <sulkan/job_system.h>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define SK_SKINNING_SSE
+#endif
+
+skSkinnedMesh skSkinnedMesh_Create(const skMesh* mesh)
+{
+    skSkinnedMesh skinned = {0};
+
+    const skVertex* vertices = (const skVertex*)mesh->vertices->data;
+    int             count = (int)mesh->vertices->size;
+
+    skinned.vertexCount = count;
+    skinned.paddedCount = (count + 3) & ~3;
+
+    // 6 bind pose, 2 influence and 6 skinned arrays, ints and floats
+    // are the same size
+    int    arrays = 12 + 2 * SK_MAX_BONE_INFLUENCE;
+    float* memory = (float*)calloc(
+        (size_t)arrays * skinned.paddedCount, sizeof(float));
+    skinned.memory = memory;
+
+    int padded = skinned.paddedCount;
+    for (int c = 0; c < 3; c++)
+    {
+        skinned.positions[c] = memory;
+        skinned.normals[c] = memory + padded;
+        skinned.skinnedPositions[c] = memory + 2 * padded;
+        skinned.skinnedNormals[c] = memory + 3 * padded;
+        memory += 4 * padded;
+    }
+    for (int k = 0; k < SK_MAX_BONE_INFLUENCE; k++)
+    {
+        skinned.boneIDs[k] = (int*)memory;
+        skinned.weights[k] = memory + padded;
+        memory += 2 * padded;
+    }
+
+    int maxBoneID = -1;
+    for (int i = 0; i < skinned.paddedCount; i++)
+    {
+        if (i >= count)
+        {
+            // Padding, a valid normal keeps the normalize finite
+            skinned.normals[2][i] = 1.0f;
+            skinned.weights[0][i] = 1.0f;
+            continue;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            skinned.positions[c][i] = vertices[i].position[c];
+            skinned.normals[c][i] = vertices[i].normal[c];
+        }
+
+        // Unused influences point at the identity with no weight, a
+        // vertex with no bones gets the identity at full weight
+        bool hasBones = false;
+        for (int k = 0; k < SK_MAX_BONE_INFLUENCE; k++)
+        {
+            int id = vertices[i].boneIDs[k];
+            if (id < 0)
+                continue;
+
+            skinned.boneIDs[k][i] = id + 1;
+            skinned.weights[k][i] = vertices[i].weights[k];
+            hasBones = true;
+
+            if (id > maxBoneID)
+                maxBoneID = id;
+        }
+
+        if (!hasBones)
+            skinned.weights[0][i] = 1.0f;
+    }
+
+    skinned.paletteCount = maxBoneID + 2;
+    skinned.palette =
+        (mat4*)malloc(skinned.paletteCount * sizeof(mat4));
+
+    return skinned;
+}
+
+void skSkinnedMesh_Free(skSkinnedMesh* mesh)
+{
+    free(mesh->memory);
+    free(mesh->palette);
+    *mesh = (skSkinnedMesh) {0};
+}
+
+#ifdef SK_SKINNING_SSE
+
+// Skins the 4 vertices starting at base
+static void skSkinnedMesh_SkinGroup(skSkinnedMesh* mesh, int base)
+{
+    // The blended matrices of the 4 vertices, columns 0 to 3 of rows
+    // 0 to 2, one vertex per lane
+    __m128 m[4][3];
+    for (int c = 0; c < 4; c++)
+    {
+        m[c][0] = m[c][1] = m[c][2] = _mm_setzero_ps();
+    }
+
+    for (int k = 0; k < SK_MAX_BONE_INFLUENCE; k++)
+    {
+        const int* ids = mesh->boneIDs[k] + base;
+        __m128     weight = _mm_loadu_ps(mesh->weights[k] + base);
+
+        const float* b0 = (const float*)mesh->palette[ids[0]];
+        const float* b1 = (const float*)mesh->palette[ids[1]];
+        const float* b2 = (const float*)mesh->palette[ids[2]];
+        const float* b3 = (const float*)mesh->palette[ids[3]];
+
+        for (int c = 0; c < 4; c++)
+        {
+            // Transposing the column of each vertex's bone puts each
+            // row of it in its own register, a lane per vertex
+            __m128 r0 = _mm_loadu_ps(b0 + c * 4);
+            __m128 r1 = _mm_loadu_ps(b1 + c * 4);
+            __m128 r2 = _mm_loadu_ps(b2 + c * 4);
+            __m128 r3 = _mm_loadu_ps(b3 + c * 4);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            m[c][0] = _mm_add_ps(m[c][0], _mm_mul_ps(r0, weight));
+            m[c][1] = _mm_add_ps(m[c][1], _mm_mul_ps(r1, weight));
+            m[c][2] = _mm_add_ps(m[c][2], _mm_mul_ps(r2, weight));
+        }
+    }
+
+    __m128 px = _mm_loadu_ps(mesh->positions[0] + base);
+    __m128 py = _mm_loadu_ps(mesh->positions[1] + base);
+    __m128 pz = _mm_loadu_ps(mesh->positions[2] + base);
+    __m128 nx = _mm_loadu_ps(mesh->normals[0] + base);
+    __m128 ny = _mm_loadu_ps(mesh->normals[1] + base);
+    __m128 nz = _mm_loadu_ps(mesh->normals[2] + base);
+
+    __m128 normal[3];
+    for (int r = 0; r < 3; r++)
+    {
+        __m128 position = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(m[0][r], px),
+                       _mm_mul_ps(m[1][r], py)),
+            _mm_add_ps(_mm_mul_ps(m[2][r], pz), m[3][r]));
+        _mm_storeu_ps(mesh->skinnedPositions[r] + base, position);
+
+        normal[r] = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(m[0][r], nx),
+                       _mm_mul_ps(m[1][r], ny)),
+            _mm_mul_ps(m[2][r], nz));
+    }
+
+    __m128 length = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(normal[0], normal[0]),
+                   _mm_mul_ps(normal[1], normal[1])),
+        _mm_mul_ps(normal[2], normal[2]));
+    length = _mm_sqrt_ps(_mm_max_ps(length, _mm_set1_ps(1e-20f)));
+
+    for (int r = 0; r < 3; r++)
+    {
+        _mm_storeu_ps(mesh->skinnedNormals[r] + base,
+                      _mm_div_ps(normal[r], length));
+    }
+}
+
+#else
+
+static void skSkinnedMesh_SkinGroup(skSkinnedMesh* mesh, int base)
+{
+    for (int i = base; i < base + 4; i++)
+    {
+        mat4 m = GLM_MAT4_ZERO_INIT;
+        for (int k = 0; k < SK_MAX_BONE_INFLUENCE; k++)
+        {
+            const float* bone =
+                (const float*)mesh->palette[mesh->boneIDs[k][i]];
+            float weight = mesh->weights[k][i];
+
+            for (int e = 0; e < 16; e++)
+            {
+                ((float*)m)[e] += bone[e] * weight;
+            }
+        }
+
+        vec3 normal;
+        for (int r = 0; r < 3; r++)
+        {
+            mesh->skinnedPositions[r][i] =
+                m[0][r] * mesh->positions[0][i] +
+                m[1][r] * mesh->positions[1][i] +
+                m[2][r] * mesh->positions[2][i] + m[3][r];
+
+            normal[r] = m[0][r] * mesh->normals[0][i] +
+                        m[1][r] * mesh->normals[1][i] +
+                        m[2][r] * mesh->normals[2][i];
+        }
+
+        float length =
+            sqrtf(glm_max(glm_vec3_norm2(normal), 1e-20f));
+        for (int r = 0; r < 3; r++)
+        {
+            mesh->skinnedNormals[r][i] = normal[r] / length;
+        }
+    }
+}
+
+#endif
+
+static void skSkinnedMesh_SkinRange(void* userdata, size_t begin,
+                                    size_t end, int thread)
+{
+    (void)thread;
+    skSkinnedMesh* mesh = (skSkinnedMesh*)userdata;
+
+    for (size_t group = begin; group < end; group++)
+    {
+        skSkinnedMesh_SkinGroup(mesh, (int)group * 4);
+    }
+}
+
+void skSkinnedMesh_Skin(skSkinnedMesh* mesh, const mat4* boneMatrices,
+                        int boneCount)
+{
+    if (mesh->vertexCount == 0)
+        return;
+
+    glm_mat4_identity(mesh->palette[0]);
+    for (int i = 1; i < mesh->paletteCount; i++)
+    {
+        if (i - 1 < boneCount)
+        {
+            glm_mat4_copy((vec4*)boneMatrices[i - 1],
+                          mesh->palette[i]);
+        }
+        else
+        {
+            glm_mat4_identity(mesh->palette[i]);
+        }
+    }
+
+    // A few hundred vertices per range is enough to be worth a job
+    skJobSystem_ParallelFor(mesh->paddedCount / 4, 64,
+                            skSkinnedMesh_SkinRange, mesh);
+}
+
+void skSkinnedMesh_SkinWithAnimator(skSkinnedMesh* mesh,
+                                    skAnimator*    animator)
+{
+    skSkinnedMesh_Skin(mesh, (mat4*)animator->finalBoneMatrices->data,
+                       (int)animator->finalBoneMatrices->size);
+}
+
+void skSkinnedMesh_GetPosition(const skSkinnedMesh* mesh, int vertex,
+                               vec3 dest)
+{
+    for (int c = 0; c < 3; c++)
+    {
+        dest[c] = mesh->skinnedPositions[c][vertex];
+    }
+}
+
+void skSkinnedMesh_GetNormal(const skSkinnedMesh* mesh, int vertex,
+                             vec3 dest)
+{
+    for (int c = 0; c < 3; c++)
+    {
+        dest[c] = mesh->skinnedNormals[c][vertex];
+    }
+}
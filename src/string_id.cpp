@@ -0,0 +1,68 @@
+#include <sulkan/string_id.h>
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interned strings never move (a deque doesn't move its elements) so
+// the map can key on views of them and the pointers handed out stay
+// valid. Interning happens while loading, possibly on several threads
+// at once, so the table is behind a lock
+static std::shared_mutex                                g_stringMutex;
+static std::deque<std::string>                          g_strings;
+static std::unordered_map<std::string_view, skStringID> g_stringIds;
+
+extern "C"
+{
+
+skStringID skStringID_Intern(const char* str)
+{
+    if (!str)
+        return SK_STRING_ID_NONE;
+
+    std::string_view view(str);
+
+    {
+        std::shared_lock<std::shared_mutex> lock(g_stringMutex);
+        auto it = g_stringIds.find(view);
+        if (it != g_stringIds.end())
+            return it->second;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(g_stringMutex);
+
+    // Someone else could have added it between the locks
+    auto it = g_stringIds.find(view);
+    if (it != g_stringIds.end())
+        return it->second;
+
+    g_strings.emplace_back(view);
+    skStringID id = (skStringID)g_strings.size();
+    g_stringIds.emplace(g_strings.back(), id);
+
+    return id;
+}
+
+skStringID skStringID_Find(const char* str)
+{
+    if (!str)
+        return SK_STRING_ID_NONE;
+
+    std::shared_lock<std::shared_mutex> lock(g_stringMutex);
+    auto it = g_stringIds.find(std::string_view(str));
+    return it != g_stringIds.end() ? it->second : SK_STRING_ID_NONE;
+}
+
+const char* skStringID_String(skStringID id)
+{
+    std::shared_lock<std::shared_mutex> lock(g_stringMutex);
+    if (id == SK_STRING_ID_NONE || id > g_strings.size())
+        return "";
+
+    return g_strings[id - 1].c_str();
+}
+
+} // extern "C"
@@ -0,0 +1,440 @@
+#include <sulkan/transform.h>
+#include <sulkan/render_association.h>
+#include <sulkan/physics_3d.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#define SK_TRANSFORM_SSE
+#endif
+
+// The hierarchy flattened breadth first, a parent's slot always comes
+// before its children's and siblings are next to each other. Matrices
+// are 16 floats each, column major like cglm's mat4
+typedef struct skTransformHierarchy
+{
+    skSceneHandle scene;
+    size_t        count;
+    size_t        capacity;
+    size_t        parentCount;
+
+    skEntityID*    entities;
+    int*           parentSlots; // -1 for roots
+    float*         locals;
+    float*         worlds;
+    unsigned char* dirty;
+
+    // Slot i of level l is in [levelStarts[l], levelStarts[l + 1])
+    int*   levelStarts;
+    size_t levelCount;
+
+    // Dirty slots of the level being updated
+    int*          batch;
+    skTransform** batchTransforms;
+
+    // Only used while rebuilding
+    skEntityID* unsortedEntities;
+    int*        unsortedParents;
+    int*        childStarts;
+    int*        children;
+    int*        order;
+
+    // Entity index to slot
+    int*   slotOfIndex;
+    size_t indexCapacity;
+} skTransformHierarchy;
+
+static skTransformHierarchy hierarchy;
+
+static skECSQuery transformQuery = NULL;
+static skECSQuery changedQuery = NULL;
+static skECSQuery parentQuery = NULL;
+
+static void skTransformHierarchy_Reserve(skTransformHierarchy* h,
+                                         size_t count)
+{
+    if (count <= h->capacity)
+        return;
+
+    size_t capacity = h->capacity ? h->capacity : 64;
+    while (capacity < count) { capacity *= 2; }
+
+    h->entities = realloc(h->entities, capacity * sizeof(skEntityID));
+    h->parentSlots = realloc(h->parentSlots, capacity * sizeof(int));
+    h->locals = realloc(h->locals, capacity * 16 * sizeof(float));
+    h->worlds = realloc(h->worlds, capacity * 16 * sizeof(float));
+    h->dirty = realloc(h->dirty, capacity);
+    h->levelStarts =
+        realloc(h->levelStarts, (capacity + 1) * sizeof(int));
+    h->batch = realloc(h->batch, capacity * sizeof(int));
+    h->batchTransforms =
+        realloc(h->batchTransforms, capacity * sizeof(skTransform*));
+    h->unsortedEntities =
+        realloc(h->unsortedEntities, capacity * sizeof(skEntityID));
+    h->unsortedParents =
+        realloc(h->unsortedParents, capacity * sizeof(int));
+    h->childStarts =
+        realloc(h->childStarts, (capacity + 1) * sizeof(int));
+    h->children = realloc(h->children, capacity * sizeof(int));
+    h->order = realloc(h->order, capacity * sizeof(int));
+
+    h->capacity = capacity;
+}
+
+static int skTransformHierarchy_SlotOf(skTransformHierarchy* h,
+                                       skEntityID entity)
+{
+    size_t index = (size_t)(entity >> 32);
+    if (index >= h->indexCapacity)
+        return -1;
+
+    return h->slotOfIndex[index];
+}
+
+static void skTransformHierarchy_SetSlot(skTransformHierarchy* h,
+                                         skEntityID entity, int slot)
+{
+    size_t index = (size_t)(entity >> 32);
+    if (index >= h->indexCapacity)
+    {
+        size_t capacity = h->indexCapacity ? h->indexCapacity : 1024;
+        while (capacity <= index) { capacity *= 2; }
+
+        h->slotOfIndex =
+            realloc(h->slotOfIndex, capacity * sizeof(int));
+        memset(h->slotOfIndex + h->indexCapacity, 0xFF,
+               (capacity - h->indexCapacity) * sizeof(int));
+        h->indexCapacity = capacity;
+    }
+
+    h->slotOfIndex[index] = slot;
+}
+
+// Walks the hierarchy breadth first from the roots, returns how many
+// nodes were reached, the rest have parents that form a cycle
+static size_t skTransformHierarchy_Sort(skTransformHierarchy* h)
+{
+    size_t count = h->count;
+    size_t sorted = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (h->unsortedParents[i] < 0)
+        {
+            h->order[sorted++] = (int)i;
+        }
+    }
+
+    h->levelCount = 0;
+    size_t levelStart = 0;
+    size_t levelEnd = sorted;
+
+    while (levelStart < levelEnd)
+    {
+        h->levelStarts[h->levelCount++] = (int)levelStart;
+
+        for (size_t i = levelStart; i < levelEnd; i++)
+        {
+            int node = h->order[i];
+            for (int c = h->childStarts[node];
+                 c < h->childStarts[node + 1]; c++)
+            {
+                // Skip children cut off to break a cycle
+                int child = h->children[c];
+                if (h->unsortedParents[child] == node)
+                    h->order[sorted++] = child;
+            }
+        }
+
+        levelStart = levelEnd;
+        levelEnd = sorted;
+    }
+
+    h->levelStarts[h->levelCount] = (int)sorted;
+
+    return sorted;
+}
+
+static void skTransformHierarchy_Rebuild(skTransformHierarchy* h,
+                                         skSceneHandle scene)
+{
+    size_t count = skECS_QueryCount(transformQuery);
+    skTransformHierarchy_Reserve(h, count);
+
+    if (h->indexCapacity)
+    {
+        memset(h->slotOfIndex, 0xFF, h->indexCapacity * sizeof(int));
+    }
+
+    // Index the entities in query order first, then find the parents
+    h->count = 0;
+    SK_ECS_QUERY_START(transformQuery)
+    {
+        h->unsortedEntities[h->count] = _entity;
+        skTransformHierarchy_SetSlot(h, _entity, (int)h->count);
+        h->count++;
+    }
+    SK_ECS_QUERY_END();
+
+    count = h->count;
+    memset(h->childStarts, 0, (count + 1) * sizeof(int));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        skParent* parent =
+            SK_ECS_GET(scene, h->unsortedEntities[i], skParent);
+
+        // A parent without a skTransform (or that was destroyed)
+        // leaves the entity a root
+        int p = -1;
+        if (parent)
+        {
+            p = skTransformHierarchy_SlotOf(h, parent->parent);
+            if (p >= 0 && h->unsortedEntities[p] != parent->parent)
+                p = -1;
+        }
+
+        h->unsortedParents[i] = p;
+        if (p >= 0)
+            h->childStarts[p + 1]++;
+    }
+
+    // Children lists, grouped by parent
+    for (size_t i = 0; i < count; i++)
+    {
+        h->childStarts[i + 1] += h->childStarts[i];
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        h->order[i] = h->childStarts[i];
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int p = h->unsortedParents[i];
+        if (p >= 0)
+            h->children[h->order[p]++] = (int)i;
+    }
+
+    size_t sorted;
+    while ((sorted = skTransformHierarchy_Sort(h)) < count)
+    {
+        // Find a node that wasn't reached and cut it from its parent
+        memset(h->batch, 0, count * sizeof(int));
+        for (size_t i = 0; i < sorted; i++)
+        {
+            h->batch[h->order[i]] = 1;
+        }
+
+        int node = 0;
+        while (h->batch[node]) { node++; }
+
+        // It could hang below the cycle, walking up far enough is
+        // sure to end inside it
+        for (size_t i = 0; i < count; i++)
+        {
+            node = h->unsortedParents[node];
+        }
+
+        printf("SK ERROR: Entity %llu is its own ancestor, treating "
+               "it as a root\n",
+               (unsigned long long)h->unsortedEntities[node]);
+
+        h->unsortedParents[node] = -1;
+    }
+
+    // order maps slots to unsorted indices, turn it around so parents
+    // can be looked up by slot
+    for (size_t slot = 0; slot < count; slot++)
+    {
+        int i = h->order[slot];
+        h->entities[slot] = h->unsortedEntities[i];
+        h->batch[i] = (int)slot;
+    }
+
+    for (size_t slot = 0; slot < count; slot++)
+    {
+        int p = h->unsortedParents[h->order[slot]];
+        h->parentSlots[slot] = p >= 0 ? h->batch[p] : -1;
+        skTransformHierarchy_SetSlot(h, h->entities[slot], (int)slot);
+    }
+
+    if (count)
+        memset(h->dirty, 1, count);
+    h->parentCount = skECS_QueryCount(parentQuery);
+}
+
+// world[s] = world[parent of s] * local[s] for every slot in the
+// batch, all parents have to be up to date already
+static void skTransform_MulBatch(float* worlds, const float* locals,
+                                 const int* parentSlots,
+                                 const int* batch, size_t count)
+{
+#ifdef SK_TRANSFORM_SSE
+    __m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+#endif
+    int loaded = -1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int          s = batch[i];
+        int          p = parentSlots[s];
+        float*       out = worlds + (size_t)s * 16;
+        const float* b = locals + (size_t)s * 16;
+
+        if (p < 0)
+        {
+            memcpy(out, b, 16 * sizeof(float));
+            continue;
+        }
+
+        const float* a = worlds + (size_t)p * 16;
+
+#ifdef SK_TRANSFORM_SSE
+        // Siblings are next to each other so the parent usually stays
+        // in registers
+        if (p != loaded)
+        {
+            a0 = _mm_loadu_ps(a);
+            a1 = _mm_loadu_ps(a + 4);
+            a2 = _mm_loadu_ps(a + 8);
+            a3 = _mm_loadu_ps(a + 12);
+            loaded = p;
+        }
+
+        for (int c = 0; c < 4; c++)
+        {
+            const float* column = b + c * 4;
+
+            __m128 r = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+            _mm_storeu_ps(out + c * 4, r);
+        }
+#else
+        (void)loaded;
+        for (int c = 0; c < 4; c++)
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                out[c * 4 + r] = a[r] * b[c * 4 + 0] +
+                                 a[4 + r] * b[c * 4 + 1] +
+                                 a[8 + r] * b[c * 4 + 2] +
+                                 a[12 + r] * b[c * 4 + 3];
+            }
+        }
+#endif
+    }
+}
+
+void skTransform_Sys(skECSState* state)
+{
+    skTransformHierarchy* h = &hierarchy;
+
+    SK_ECS_QUERY(transformQuery, state->scene,
+                 SK_ECS_COMPONENT_TYPE(skTransform));
+
+    SK_ECS_QUERY(changedQuery, state->scene,
+                 SK_ECS_COMPONENT_TYPE(skTransform));
+    SK_ECS_QUERY(parentQuery, state->scene,
+                 SK_ECS_COMPONENT_TYPE(skTransform),
+                 SK_ECS_COMPONENT_TYPE(skParent));
+    skECS_QuerySetFilter(changedQuery, 0, skECSQueryFilter_Changed);
+    skECS_QuerySetFilter(parentQuery, 1, skECSQueryFilter_Changed);
+
+    // The order only has to be rebuilt when entities join or leave
+    // the hierarchy or get a new parent
+    bool rebuild = h->scene != state->scene ||
+                   h->count != skECS_QueryCount(transformQuery) ||
+                   h->parentCount != skECS_QueryCount(parentQuery);
+
+    SK_ECS_QUERY_START(parentQuery) { rebuild = true; }
+    SK_ECS_QUERY_END();
+
+    SK_ECS_QUERY_START(changedQuery)
+    {
+        int slot = skTransformHierarchy_SlotOf(h, _entity);
+        if (slot < 0 || (size_t)slot >= h->count ||
+            h->entities[slot] != _entity)
+        {
+            rebuild = true;
+        }
+        else
+        {
+            h->dirty[slot] = 1;
+        }
+    }
+    SK_ECS_QUERY_END();
+
+    if (rebuild)
+    {
+        skTransformHierarchy_Rebuild(h, state->scene);
+        h->scene = state->scene;
+    }
+
+    for (size_t level = 0; level < h->levelCount; level++)
+    {
+        size_t batchCount = 0;
+
+        for (int s = h->levelStarts[level];
+             s < h->levelStarts[level + 1]; s++)
+        {
+            int p = h->parentSlots[s];
+            if (!h->dirty[s] && (p < 0 || !h->dirty[p]))
+                continue;
+
+            h->dirty[s] = 1;
+
+            skTransform* transform = SK_ECS_QUERY_GET(
+                transformQuery, h->entities[s], 0, skTransform);
+
+            mat4 local = GLM_MAT4_IDENTITY_INIT;
+            glm_translate(local, transform->position);
+            glm_quat_rotate(local, transform->rotation, local);
+            glm_scale(local, transform->scale);
+            memcpy(h->locals + (size_t)s * 16, local, sizeof(mat4));
+
+            h->batch[batchCount] = s;
+            h->batchTransforms[batchCount] = transform;
+            batchCount++;
+        }
+
+        skTransform_MulBatch(h->worlds, h->locals, h->parentSlots,
+                             h->batch, batchCount);
+
+        for (size_t i = 0; i < batchCount; i++)
+        {
+            int          s = h->batch[i];
+            const float* world = h->worlds + (size_t)s * 16;
+            memcpy(h->batchTransforms[i]->world, world, sizeof(mat4));
+
+            // Physics owns the render transform of rigidbodies
+            if (SK_ECS_GET(state->scene, h->entities[s],
+                           skRigidbody3D))
+            {
+                continue;
+            }
+
+            skRenderAssociation* assoc = SK_ECS_GET(
+                state->scene, h->entities[s], skRenderAssociation);
+            if (assoc && assoc->objectIndex >= 0 &&
+                (size_t)assoc->objectIndex <
+                    state->renderer->renderObjects->size)
+            {
+                skRenderObject* obj =
+                    (skRenderObject*)skVector_Get(
+                        state->renderer->renderObjects,
+                        assoc->objectIndex);
+                memcpy(obj->transform, world, sizeof(mat4));
+            }
+        }
+    }
+
+    if (h->count)
+        memset(h->dirty, 0, h->count);
+}